@@ -0,0 +1,211 @@
+// throughput of elf2dll from a 2 KB to a 2 MB DLL, on synthetic inputs
+// written by synth_write, see "make bench"
+
+#include "synth.hpp"
+
+#include <elfio/elfio.hpp>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "elf2dll.hpp"
+#include "utils.h"
+
+using namespace std;
+using namespace ELFIO;
+
+#define BENCH_MIN_TIME  (0.25)
+#define BENCH_MIN_RUNS  (3)
+
+typedef chrono::steady_clock bench_clock;
+
+static double bench_seconds(bench_clock::time_point start)
+{
+	return chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// repeats a kernel until it ran long enough to time, returns seconds per run
+template <typename T>
+static double bench_run(T kernel)
+{
+	double elapsed = 0;
+	int runs = 0;
+
+	while (runs < BENCH_MIN_RUNS || elapsed < BENCH_MIN_TIME)
+	{
+		elapsed += kernel();
+		runs++;
+	}
+
+	return elapsed / runs;
+}
+
+static void bench_report(const string& tier, const string& kernel, double seconds, u64 relocs, u64 bytes)
+{
+	cout << left << setw(6) << tier << setw(18) << kernel << right;
+	cout << fixed << setprecision(3) << setw(12) << seconds * 1e6 << " us";
+
+	if (relocs)
+		cout << setprecision(2) << setw(12) << relocs / seconds / 1e6 << " Mrelocs/s";
+	else
+		cout << setw(22) << "";
+
+	if (bytes)
+		cout << setprecision(1) << setw(10) << bytes / seconds / (1024.0 * 1024.0) << " MB/s";
+
+	cout << endl;
+}
+
+class dino_bench {
+public:
+	static size_t dll_size(dino_dll& dll) { return dll.dll_size; }
+	static size_t reltext_size(dino_dll& dll) { return dll.reltext.size(); }
+
+	static u64 relocs(dino_dll& dll)
+	{
+		return dll.reltext.size() + dll.relrodata.size() + dll.reldata.size() + dll.relexports.size();
+	}
+
+	// rebuilds the GOT over a fresh copy of .text on every run
+	static double gotable(dino_dll& dll)
+	{
+		memcpy(dll.text, dll.role_data(ROLE_TEXT), dll.role_size(ROLE_TEXT));
+
+		bench_clock::time_point start = bench_clock::now();
+		dll.gotable_build();
+		return bench_seconds(start);
+	}
+};
+
+static bool bench_tier(const string& dir, const string& tier, u32 size)
+{
+	synth_params params;
+	memset(&params, 0, sizeof(params));
+	synth_scale(params, size);
+
+	string elf_file = dir + "/" + tier + ".o";
+	string dll_file = dir + "/" + tier + ".dll";
+
+	if (!synth_write(params, elf_file))
+	{
+		cerr << "Unable to write " << elf_file << "." << endl;
+		return false;
+	}
+
+	vector<u8> input;
+	ifstream stream(elf_file, ios::binary);
+	input.assign(istreambuf_iterator<char>(stream), istreambuf_iterator<char>());
+
+	ostringstream diag;
+	dino_dll dll(diag);
+	if (dll.convert(elf_file))
+	{
+		cerr << diag.str();
+		return false;
+	}
+
+	u64 relocs = dino_bench::relocs(dll);
+	u64 bytes = input.size();
+
+	cout << tier << ": " << bytes << " byte ELF, " << dino_bench::dll_size(dll) << " byte DLL, ";
+	cout << relocs << " relocations" << endl;
+
+	double seconds;
+
+	seconds = bench_run([&]() {
+		bench_clock::time_point start = bench_clock::now();
+		elfio elf;
+		elf.load(elf_file);
+		return bench_seconds(start);
+	});
+	bench_report(tier, "elfio::load", seconds, 0, bytes);
+
+	seconds = bench_run([&]() {
+		bench_clock::time_point start = bench_clock::now();
+		elfio elf;
+		elf.load_mapped(elf_file);
+		return bench_seconds(start);
+	});
+	bench_report(tier, "load_mapped", seconds, 0, bytes);
+
+	seconds = bench_run([&]() {
+		bench_clock::time_point start = bench_clock::now();
+		dino_dll dll(diag);
+		dll.convert(elf_file);
+		return bench_seconds(start);
+	});
+	bench_report(tier, "convert", seconds, relocs, bytes);
+
+	seconds = bench_run([&]() {
+		bench_clock::time_point start = bench_clock::now();
+		dino_dll dll(diag);
+		dll.build(elf_file, dll_file);
+		return bench_seconds(start);
+	});
+	bench_report(tier, "build", seconds, relocs, bytes);
+
+	seconds = bench_run([&]() {
+		return dino_bench::gotable(dll);
+	});
+	bench_report(tier, "gotable_build", seconds, dino_bench::reltext_size(dll), 0);
+
+	cout << endl;
+	return true;
+}
+
+static void bench_endian(void)
+{
+	vector<u8> buffer(16 * 1024 * 1024);
+	u32 sum = 0;
+
+	double seconds = bench_run([&]() {
+		bench_clock::time_point start = bench_clock::now();
+		for (size_t i = 0; i < buffer.size(); i += sizeof(u32))
+			putbe32(&buffer[i], (u32) i);
+		return bench_seconds(start);
+	});
+	bench_report("-", "putbe32", seconds, 0, buffer.size());
+
+	seconds = bench_run([&]() {
+		bench_clock::time_point start = bench_clock::now();
+		for (size_t i = 0; i < buffer.size(); i += sizeof(u32))
+			sum += getbe32(&buffer[i]);
+		return bench_seconds(start);
+	});
+	bench_report("-", "getbe32", seconds, 0, buffer.size());
+
+	// keep the loop from being optimised away
+	if (sum == 0xDEADBEEF) cout << endl;
+	cout << endl;
+}
+
+int main(int argc, const char* argv[])
+{
+	string dir = argc > 1 ? argv[1] : ".";
+
+	static const struct {
+		const char* tier;
+		u32 size;
+	} tiers[] = {
+		{ "2K", 2 * 1024 },
+		{ "8K", 8 * 1024 },
+		{ "32K", 32 * 1024 },
+		{ "128K", 128 * 1024 },
+		{ "512K", 512 * 1024 },
+		{ "2M", 2 * 1024 * 1024 },
+	};
+
+	bench_endian();
+
+	for (size_t i = 0; i < sizeof(tiers) / sizeof(tiers[0]); i++)
+	{
+		if (!bench_tier(dir, tiers[i].tier, tiers[i].size))
+			return 1;
+	}
+
+	return 0;
+}
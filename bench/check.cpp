@@ -0,0 +1,685 @@
+// regression checks of elf2dll on synthetic inputs written by synth_write,
+// see "make check"; prints one line per check and fails if any did
+
+#include "synth.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "elf2dll.hpp"
+#include "dll2elf.hpp"
+#include "loader.hpp"
+#include "verify.hpp"
+#include "libelf2dll.h"
+#include "fileio.hpp"
+#include "utils.h"
+
+using namespace std;
+
+// lw rt, imm($gp)
+#define CHECK_LW_GP       (0x8F800000)
+#define CHECK_LW_GP_MASK  (0xFFE0FFFF)
+#define CHECK_LW_V0_GP    (0x8F820000)
+#define CHECK_ADDIU_V0_V0 (0x24420000)
+#define CHECK_ADDIU_V0_GP (0x27820000)
+#define CHECK_JR_RA       (0x03E00008)
+
+static int checked = 0;
+static int failed = 0;
+
+static bool check(bool ok, const string& what, const string& detail = "")
+{
+	checked++;
+	if (!ok) failed++;
+
+	cout << (ok ? "ok      " : "FAILED  ") << what << endl;
+	if (!ok && !detail.empty())
+		cout << detail;
+
+	return ok;
+}
+
+static bool contains(const string& text, const string& part)
+{
+	return text.find(part) != string::npos;
+}
+
+// a small object where every function is exported, so nothing is left to
+// guess when the DLL is taken apart again
+static synth_params check_params(u32 dll_size, u32 seed)
+{
+	synth_params params;
+	memset(&params, 0, sizeof(params));
+	synth_scale(params, dll_size);
+
+	params.exports = params.gp_disp;
+	params.seed = seed;
+	return params;
+}
+
+static bool check_fixture(const string& dir, const string& name, const synth_params& params, const dino_options& options, string& dll_file)
+{
+	string elf_file = dir + "/" + name + ".o";
+	dll_file = dir + "/" + name + ".dll";
+
+	if (!check(synth_write(params, elf_file), name + ": write the object"))
+		return false;
+
+	ostringstream diag;
+	dino_dll dll(options, diag);
+	return check(dll.build(elf_file, dll_file) == 0, name + ": convert", diag.str());
+}
+
+// the GOT of a DLL, every slot before GOTEND
+static vector<u32> check_got(const vector<u8>& image)
+{
+	vector<u32> got;
+	const dino_dll_header* header = (const dino_dll_header*) &image[0];
+
+	for (size_t offset = getbe32(header->rodata_offset); offset + sizeof(u32) <= image.size(); offset += sizeof(u32))
+	{
+		u32 slot = getbe32(&image[offset]);
+		if (slot == DINO_GOTEND) break;
+
+		got.push_back(slot);
+	}
+
+	return got;
+}
+
+// how many words of .text load the given GOT slot
+static size_t check_loads(const vector<u8>& image, u32 slot)
+{
+	const dino_dll_header* header = (const dino_dll_header*) &image[0];
+	size_t count = 0;
+
+	for (size_t offset = getbe32(header->header_size); offset + sizeof(u32) <= getbe32(header->rodata_offset); offset += sizeof(u32))
+	{
+		if ((getbe32(&image[offset]) & CHECK_LW_GP_MASK) == (CHECK_LW_GP | (u32) (slot * sizeof(u32))))
+			count++;
+	}
+
+	return count;
+}
+
+static bool check_unused(const vector<u32>& got)
+{
+	return find(got.begin(), got.end(), DINO_NONE) != got.end();
+}
+
+// every GOT slot is used and GOTEND comes right after the last one, however
+// many references land on a section base
+static void check_gotable(const string& dir)
+{
+	dino_options options;
+	vector<u8> image;
+	string dll_file;
+
+	// the only GOT user is a call past the start of .text, so no reference
+	// shares a base slot
+	synth_params call = check_params(0x800, 1);
+	call.got16 = 0;
+	call.call16 = 1;
+	call.gp_disp = 0;
+	call.exports = 5;
+
+	if (check_fixture(dir, "got-call", call, options, dll_file) && file_read(dll_file, image))
+		check(check_got(image).size() == 5, "got-call: GOTEND follows the slot of the call");
+
+	// GOT16 pages of .rodata, .data and .bss all land on their bases
+	if (check_fixture(dir, "got-bases", check_params(0x4000, 9), options, dll_file) && file_read(dll_file, image))
+	{
+		check(check_loads(image, 1) && check_loads(image, 2) && check_loads(image, 3), "got-bases: references reach several section bases");
+		check(!check_unused(check_got(image)), "got-bases: no GOT slot is left unused");
+	}
+
+	// an empty .rodata starts where .data does, yet .data keeps its own slot
+	synth_params empty = check_params(0x4000, 10);
+	empty.rodata_size = 0;
+	empty.gprel32 = 0;
+
+	if (check_fixture(dir, "got-empty", empty, options, dll_file) && file_read(dll_file, image))
+	{
+		vector<u32> got = check_got(image);
+		check(got.size() > 4 && got[1] == got[2], "got-empty: .rodata and .data start at the same offset");
+		check(!check_loads(image, 1) && check_loads(image, 2), "got-empty: .data references take the .data slot");
+		check(!check_unused(got), "got-empty: no GOT slot is left unused");
+	}
+}
+
+// one string repeated past 64 KB, then another; merged, both end up in the
+// first page, so every GOT16 against them needs a new upper half
+static const char* check_strings[] = { "uplicate-string", "duplicate-string", "unique" };
+
+static bool check_merged_write(const string& elf_file, u32 copies)
+{
+	const string repeated = "duplicate-string";
+	u32 size = (u32) repeated.size() + 1;
+
+	vector<u8> strings;
+	for (u32 i = 0; i < copies; i++)
+		strings.insert(strings.end(), repeated.c_str(), repeated.c_str() + size);
+
+	strings.insert(strings.end(), check_strings[2], check_strings[2] + strlen(check_strings[2]) + 1);
+
+	const u32 addends[] = { (copies - 1) * size + 1, 0, copies * size };
+	// symbols: null, the .text and string section symbols, f0 and _gp_disp
+	const u32 sym_strings = 2, sym_function = 3, sym_gp_disp = 4;
+
+	vector<u8> text(12 + 8 * 3 + 8, 0), exports(8, 0);
+	putbe32(&text[0], MIPS_LUI_GP_I16);
+	putbe32(&text[4], MIPS_ADDIU_GP_I16);
+	putbe32(&text[8], MIPS_ADDU_GP_T9);
+
+	for (u32 i = 0; i < 3; i++)
+	{
+		s64 upper = ((s64) addends[i] + 0x8000) >> 16;
+		putbe32(&text[12 + i * 8], CHECK_LW_V0_GP | (u32) upper);
+		putbe32(&text[16 + i * 8], CHECK_ADDIU_V0_V0 | ((addends[i] - (u32) (upper << 16)) & MIPS_IMMMASK));
+	}
+
+	putbe32(&text[36], CHECK_JR_RA);
+
+	elfio elf;
+	elf.create(ELFCLASS32, ELFDATA2MSB);
+	elf.set_type(ET_REL);
+	elf.set_machine(EM_MIPS);
+	elf.set_flags(0x10000007); // mips2, pic, cpic, noreorder
+
+	section* sec_text = elf.sections.add(".text");
+	sec_text->set_type(SHT_PROGBITS);
+	sec_text->set_flags(SHF_ALLOC | SHF_EXECINSTR);
+	sec_text->set_addr_align(16);
+	sec_text->set_data((const char*) &text[0], (Elf_Word) text.size());
+
+	section* sec_strings = elf.sections.add(".rodata.str1.1");
+	sec_strings->set_type(SHT_PROGBITS);
+	sec_strings->set_flags(SHF_ALLOC | SHF_MERGE | SHF_STRINGS);
+	sec_strings->set_addr_align(1);
+	sec_strings->set_entry_size(1);
+	sec_strings->set_data((const char*) &strings[0], (Elf_Word) strings.size());
+
+	section* sec_exports = elf.sections.add(".exports");
+	sec_exports->set_type(SHT_PROGBITS);
+	sec_exports->set_flags(SHF_ALLOC);
+	sec_exports->set_addr_align(4);
+	sec_exports->set_data((const char*) &exports[0], (Elf_Word) exports.size());
+
+	section* sec_strtab = elf.sections.add(".strtab");
+	sec_strtab->set_type(SHT_STRTAB);
+	sec_strtab->set_addr_align(1);
+
+	section* sec_symtab = elf.sections.add(".symtab");
+	sec_symtab->set_type(SHT_SYMTAB);
+	sec_symtab->set_addr_align(4);
+	sec_symtab->set_entry_size(elf.get_default_entry_size(SHT_SYMTAB));
+	sec_symtab->set_link(sec_strtab->get_index());
+	sec_symtab->set_info(sym_function);
+
+	string_section_accessor names(sec_strtab);
+	symbol_section_accessor symbols(elf, sec_symtab);
+
+	symbols.add_symbol(names, "", 0, 0, STB_LOCAL, STT_SECTION, STV_DEFAULT, sec_text->get_index());
+	symbols.add_symbol(names, "", 0, 0, STB_LOCAL, STT_SECTION, STV_DEFAULT, sec_strings->get_index());
+	symbols.add_symbol(names, "f0", 0, (Elf_Xword) text.size(), STB_GLOBAL, STT_FUNC, STV_DEFAULT, sec_text->get_index());
+	symbols.add_symbol(names, "_gp_disp", 0, 0, STB_GLOBAL, STT_NOTYPE, STV_DEFAULT, SHN_UNDEF);
+
+	section* rel_text = elf.sections.add(".rel.text");
+	rel_text->set_type(SHT_REL);
+	rel_text->set_info(sec_text->get_index());
+	rel_text->set_link(sec_symtab->get_index());
+	rel_text->set_addr_align(4);
+	rel_text->set_entry_size(elf.get_default_entry_size(SHT_REL));
+
+	relocation_section_accessor text_relocs(elf, rel_text);
+	text_relocs.add_entry(0, sym_gp_disp, R_MIPS_HI16);
+	text_relocs.add_entry(4, sym_gp_disp, R_MIPS_LO16);
+
+	for (u32 i = 0; i < 3; i++)
+	{
+		text_relocs.add_entry(12 + i * 8, sym_strings, R_MIPS_GOT16);
+		text_relocs.add_entry(16 + i * 8, sym_strings, R_MIPS_LO16);
+	}
+
+	section* rel_exports = elf.sections.add(".rel.exports");
+	rel_exports->set_type(SHT_REL);
+	rel_exports->set_info(sec_exports->get_index());
+	rel_exports->set_link(sec_symtab->get_index());
+	rel_exports->set_addr_align(4);
+	rel_exports->set_entry_size(elf.get_default_entry_size(SHT_REL));
+
+	relocation_section_accessor export_relocs(elf, rel_exports);
+	export_relocs.add_entry(0, sym_function, R_MIPS_32);
+	export_relocs.add_entry(4, sym_function, R_MIPS_32);
+
+	return elf.save(elf_file);
+}
+
+// the string a GOT16 at .text+offset and the LO16 after it point at
+static string check_string(const vector<u8>& image, u32 offset)
+{
+	const dino_dll_header* header = (const dino_dll_header*) &image[0];
+	u32 header_size = getbe32(header->header_size);
+	u32 table = getbe32(header->rodata_offset);
+
+	u32 upper = getbe32(&image[header_size + offset]);
+	s32 slot = (s16) (upper & MIPS_IMMMASK);
+	s32 lower = (s16) (getbe32(&image[header_size + offset + 4]) & MIPS_IMMMASK);
+
+	// a relaxed load adds its displacement to $gp, which points at the table
+	u32 entry = table - header_size + slot;
+	if ((upper & MIPS_OPMASK) != MIPS_ADDIU)
+	{
+		if (table + slot + sizeof(u32) > image.size()) return "";
+		entry = getbe32(&image[table + slot]);
+	}
+
+	size_t address = header_size + entry + lower;
+	if (address >= image.size()) return "";
+
+	const char* start = (const char*) &image[address];
+	return string(start, strnlen(start, image.size() - address));
+}
+
+// merging moves constants into another page than the one their GOT16 was
+// assembled against
+static void check_merged(const string& dir)
+{
+	string elf_file = dir + "/merged.o";
+	if (!check(check_merged_write(elf_file, 4000), "merged: write the object"))
+		return;
+
+	for (int relax = 0; relax < 2; relax++)
+	{
+		string name = relax ? "merged-relaxed" : "merged";
+		string dll_file = dir + "/" + name + ".dll";
+
+		dino_options options;
+		options.relax_loads = relax != 0;
+
+		ostringstream diag;
+		dino_dll dll(options, diag);
+
+		vector<u8> image;
+		if (!check(dll.build(elf_file, dll_file) == 0 && file_read(dll_file, image), name + ": convert", diag.str()))
+			continue;
+
+		for (u32 i = 0; i < 3; i++)
+		{
+			string found = check_string(image, 12 + i * 8);
+			check(found == check_strings[i], name + ": GOT16/LO16 pair " + to_string(i) + " reaches \"" + check_strings[i] + "\"", "    found \"" + found + "\"\n");
+		}
+	}
+}
+
+static bool same_file(const string& a, const string& b)
+{
+	vector<u8> first, second;
+	return file_read(a, first) && file_read(b, second) && first == second;
+}
+
+// dll2elf gives back an object that converts into the very same DLL
+static void check_roundtrip(const string& dir, const string& name, const synth_params& params, const dino_options& options)
+{
+	string dll_file;
+	if (!check_fixture(dir, name, params, options, dll_file))
+		return;
+
+	string elf_file = dir + "/" + name + ".rt.elf";
+	string again_file = dir + "/" + name + ".rt.dll";
+
+	ostringstream diag;
+	dino_elf elf(diag);
+	if (!check(elf.build(dll_file, elf_file) == 0, name + ": dll2elf", diag.str()))
+		return;
+
+	dino_dll dll(options, diag);
+	if (!check(dll.build(elf_file, again_file) == 0, name + ": convert the dll2elf output", diag.str()))
+		return;
+
+	check(same_file(dll_file, again_file), name + ": round trip is byte identical");
+}
+
+static void check_dll2elf(const string& dir)
+{
+	dino_options options;
+	check_roundtrip(dir, "rt-2k", check_params(0x800, 1), options);
+	check_roundtrip(dir, "rt-64k", check_params(0x10000, 2), options);
+
+	dino_options loads;
+	loads.relax_loads = true;
+	check_roundtrip(dir, "rt-loads", check_params(0x10000, 3), loads);
+
+	// a $gp setup nothing enters through $t9 can't be told apart, dll2elf
+	// has to say so rather than guess
+	synth_params hidden = check_params(0x2000, 4);
+	hidden.exports = 2;
+	hidden.call16 = 0;
+
+	string dll_file;
+	if (!check_fixture(dir, "rt-hidden", hidden, options, dll_file))
+		return;
+
+	ostringstream diag;
+	dino_elf elf(diag);
+	int ret = elf.build(dll_file, dir + "/rt-hidden.rt.elf");
+	check(ret != 0 && contains(diag.str(), "nothing enters it through $t9"), "rt-hidden: dll2elf refuses an unreferenced $gp setup", diag.str());
+}
+
+// converts in memory, for the checks that pick a DLL apart
+static bool check_image(const string& dir, const string& name, const synth_params& params, vector<u8>& image, u32& bss)
+{
+	string elf_file = dir + "/" + name + ".o";
+
+	if (!check(synth_write(params, elf_file), name + ": write the object"))
+		return false;
+
+	ostringstream diag;
+	dino_dll dll(diag);
+	return check(dll.build(vector<string>(1, elf_file), image, bss) == 0, name + ": convert", diag.str());
+}
+
+// the offset of the first entry past a table's terminator
+static size_t check_table(const vector<u8>& image, size_t offset, u32 end)
+{
+	while (offset + sizeof(u32) <= image.size() && getbe32(&image[offset]) != end)
+		offset += sizeof(u32);
+
+	return offset + sizeof(u32);
+}
+
+// loads a broken copy of the DLL with a loader that already took a good one
+static void check_broken(dino_loader& loader, ostringstream& diag, const vector<u8>& image, u32 bss, const string& what, const string& expected)
+{
+	diag.str("");
+	bool ret = loader.load(&image[0], image.size(), bss);
+	check(!ret && contains(diag.str(), expected), "loader: " + what, diag.str());
+}
+
+static void check_loader(const string& dir)
+{
+	vector<u8> first, second;
+	u32 first_bss, second_bss;
+
+	if (!check_image(dir, "load-a", check_params(0x4000, 5), first, first_bss) ||
+		!check_image(dir, "load-b", check_params(0x10000, 6), second, second_bss))
+		return;
+
+	ostringstream diag;
+	dino_loader loader(diag);
+
+	if (!check(loader.load(&first[0], first.size(), first_bss), "loader: load-a loads", diag.str()))
+		return;
+
+	dino_stats fresh = loader.get_stats();
+	check(fresh.counter("got entries") > 4 && fresh.counter("gp stubs") > 0 && fresh.counter("data words") > 0, "loader: load-a relocates its GOT, $gp setups and .data");
+
+	// the same loader goes on to the next DLL, and back, with the same result
+	check(loader.load(&second[0], second.size(), second_bss), "loader: load-b loads after load-a", diag.str());
+	check(loader.load(&first[0], first.size(), first_bss) && loader.get_stats().counter("words touched") == fresh.counter("words touched"),
+		"loader: load-a loads the same after load-b", diag.str());
+
+	const dino_dll_header* header = (const dino_dll_header*) &first[0];
+	size_t got = getbe32(header->rodata_offset);
+	size_t gptable = check_table(first, got, DINO_GOTEND);
+	size_t datable = check_table(first, gptable, DINO_GPTEND);
+	size_t data_size = first.size() - getbe32(header->data_offset);
+
+	vector<u8> broken;
+
+	broken.assign(first.begin(), first.begin() + sizeof(dino_dll_header) - 1);
+	diag.str("");
+	check(!loader.load(&broken[0], broken.size(), 0) && contains(diag.str(), "shorter than its header"), "loader: a truncated header is refused", diag.str());
+
+	broken = first;
+	putbe32(&broken[got], 4);
+	check_broken(loader, diag, broken, first_bss, "GOT slot 0 must be .text", "GOT slot 0 holds");
+
+	broken = first;
+	putbe32(&broken[got + 4 * sizeof(u32)], 0x40000000);
+	check_broken(loader, diag, broken, first_bss, "a GOT slot outside the DLL is caught", "GOT slot 4 holds");
+
+	// every slot from the GOT on points at .text, so nothing ends it
+	broken = first;
+	for (size_t i = got; i + sizeof(u32) <= broken.size(); i += sizeof(u32))
+		putbe32(&broken[i], 0);
+	check_broken(loader, diag, broken, first_bss, "a GOT without GOTEND is caught", "The GOT runs off the end");
+
+	broken = first;
+	putbe32(&broken[gptable], getbe32(&broken[gptable]) + 2 * sizeof(u32));
+	check_broken(loader, diag, broken, first_bss, "a $gp table entry off its setup is caught", "isn't a $gp setup");
+
+	broken = first;
+	putbe32(&broken[datable], (u32) data_size);
+	check_broken(loader, diag, broken, first_bss, "a .data table entry past .data is caught", "is outside .data");
+
+	// and a good DLL still loads after all that
+	diag.str("");
+	check(loader.load(&first[0], first.size(), first_bss), "loader: load-a loads after the broken ones", diag.str());
+}
+
+static string check_word(u32 word)
+{
+	ostringstream out;
+	out << "0x" << hex << setw(8) << setfill('0') << word;
+	return out.str();
+}
+
+static bool check_write(const string& file, const vector<u8>& image)
+{
+	return file_write(file, &image[0], image.size()) || check(false, "verify: write " + file);
+}
+
+// verify prints its report, what it returns only says whether all matched
+static string check_report(function<int(void)> run, int& ret)
+{
+	ostringstream report;
+	streambuf* saved = cout.rdbuf(report.rdbuf());
+	ret = run();
+	cout.rdbuf(saved);
+
+	return report.str();
+}
+
+// <dir>/output and <dir>/reference are made by "make check"
+static void check_verify(const string& dir)
+{
+	string output_dir = dir + "/output";
+	string reference_dir = dir + "/reference";
+
+	vector<u8> image;
+	u32 bss;
+	if (!check_image(dir, "verify", check_params(0x4000, 7), image, bss))
+		return;
+
+	const dino_dll_header* header = (const dino_dll_header*) &image[0];
+	size_t text = getbe32(header->header_size);
+	size_t slot = getbe32(header->rodata_offset) + 5 * sizeof(u32);
+
+	vector<u8> changed;
+
+	// the same DLL, one off in .text, one in the GOT, one cut short and one
+	// with no output at all
+	if (!check_write(output_dir + "/same.dll", image) || !check_write(reference_dir + "/same.dll", image) ||
+		!check_write(output_dir + "/text.dll", image) || !check_write(output_dir + "/got.dll", image) ||
+		!check_write(reference_dir + "/missing.dll", image))
+		return;
+
+	changed = image;
+	putbe32(&changed[text + 4], getbe32(&changed[text + 4]) ^ 0x10);
+	if (!check_write(reference_dir + "/text.dll", changed))
+		return;
+
+	changed = image;
+	putbe32(&changed[slot], getbe32(&changed[slot]) + 0x40);
+	if (!check_write(reference_dir + "/got.dll", changed))
+		return;
+
+	changed.assign(image.begin(), image.end() - 0x10);
+	if (!check_write(output_dir + "/short.dll", changed) || !check_write(reference_dir + "/short.dll", image))
+		return;
+
+	int ret = 0;
+	string report = check_report([&]() { return verify_dirs(output_dir, reference_dir, 2); }, ret);
+
+	check(ret != 0, "verify: mismatches fail the run", report);
+	check(contains(report, "text.dll: .text+0x4 is " + check_word(getbe32(&image[text + 4])) + ", the reference has " +
+		check_word(getbe32(&image[text + 4]) ^ 0x10) + "."), "verify: a .text mismatch names its offset and both words", report);
+	check(contains(report, "got.dll: GOT+0x14 is " + check_word(getbe32(&image[slot])) + ", the reference has " +
+		check_word(getbe32(&image[slot]) + 0x40) + "."), "verify: a GOT mismatch is placed in the GOT", report);
+
+	ostringstream sizes;
+	sizes << "short.dll: .data+0x" << hex << image.size() - 0x10 - getbe32(header->data_offset) << " is past the end, the reference has " <<
+		check_word(getbe32(&image[image.size() - 0x10])) << " (0x" << hex << image.size() - 0x10 << " bytes against 0x" << image.size() << ").";
+	check(contains(report, sizes.str()), "verify: a short output is reported with both sizes", report);
+
+	check(contains(report, "missing.dll: missing"), "verify: an output with no counterpart is missing", report);
+	check(!contains(report, "same.dll"), "verify: a matching DLL isn't reported", report);
+	check(contains(report, "1 of 5 DLLs match the reference, 1 missing."), "verify: the summary counts matches and missing", report);
+
+	// with the inputs at hand, a .text mismatch is traced to its relocation
+	vector<dino_job> jobs(1);
+	jobs[0].elf_files.push_back(dir + "/verify.o");
+	jobs[0].dll_file = output_dir + "/text.dll";
+
+	dino_options options;
+	report = check_report([&]() { return verify_jobs(jobs, reference_dir, options, 1); }, ret);
+
+	check(ret != 0 && contains(report, "from R_MIPS_HI16 against \"_gp_disp\", entry 0 of .rel.text."),
+		"verify: a .text mismatch is traced to its relocation", report);
+	check(!contains(report, "is stale"), "verify: an output its inputs still convert to isn't stale", report);
+
+	// a GOT16 that loads_relax rewrote is traced as a relaxed load, not by
+	// the type it no longer has
+	options.relax_loads = true;
+	jobs[0].dll_file = output_dir + "/relaxed.dll";
+
+	ostringstream diag;
+	dino_dll dll(options, diag);
+	if (!check(dll.build(jobs[0].elf_files[0], jobs[0].dll_file) == 0 && file_read(jobs[0].dll_file, image), "verify: convert with --relax-loads", diag.str()))
+		return;
+
+	size_t load = 0;
+	for (size_t offset = text; offset < getbe32(((const dino_dll_header*) &image[0])->rodata_offset) && !load; offset += sizeof(u32))
+	{
+		if ((getbe32(&image[offset]) & ~MIPS_IMMMASK) == CHECK_ADDIU_V0_GP)
+			load = offset;
+	}
+
+	if (!check(load != 0, "verify: --relax-loads rewrites a load"))
+		return;
+
+	changed = image;
+	putbe32(&changed[load], getbe32(&changed[load]) ^ 0x10);
+	if (!check_write(reference_dir + "/relaxed.dll", changed))
+		return;
+
+	report = check_report([&]() { return verify_jobs(jobs, reference_dir, options, 1); }, ret);
+
+	check(ret != 0 && contains(report, "from relaxed load of \"") && !contains(report, "R_MIPS_NONE"),
+		"verify: a relaxed load is traced as one", report);
+}
+
+// runs one object through the C API, dll is empty unless it converted
+static int check_api(const vector<u8>& elf, unsigned int flags, const char* profile, vector<u8>& dll, u32& bss, string& diag)
+{
+	const unsigned char* data = elf.empty() ? NULL : &elf[0];
+	size_t size = elf.size();
+
+	dino_result* result = dino_convert(&data, &size, 1, flags, profile);
+	if (!result) return -1;
+
+	size_t dll_size = 0;
+	const unsigned char* image = dino_result_dll(result, &dll_size);
+	dll.assign(image, image + dll_size);
+
+	int status = dino_result_status(result);
+	bss = dino_result_bss(result);
+	diag = dino_result_diag(result);
+
+	dino_result_free(result);
+	return status;
+}
+
+// dino_convert gives the bytes the command line writes, and reports a
+// failure through its status and diagnostics rather than throwing
+static void check_library(const string& dir)
+{
+	string dll_file;
+	dino_options options;
+	if (!check_fixture(dir, "api", check_params(0x8000, 8), options, dll_file))
+		return;
+
+	vector<u8> elf, expected;
+	if (!check(file_read(dir + "/api.o", elf) && file_read(dll_file, expected), "api: read the object and DLL"))
+		return;
+
+	vector<u8> dll;
+	u32 bss = 0;
+	string diag;
+
+	int status = check_api(elf, 0, NULL, dll, bss, diag);
+	check(status == 0 && diag.empty(), "api: converts with status 0 and no diagnostics", diag);
+	check(dll == expected, "api: the DLL matches the command line's");
+
+	ostringstream out;
+	dino_dll reference(options, out);
+	vector<u8> image;
+	u32 reference_bss = 0;
+	reference.build(vector<string>(1, dir + "/api.o"), image, reference_bss);
+	check(bss == reference_bss, "api: the .bss size matches the converter's");
+
+	// flags are the command line switches
+	dino_options loads;
+	loads.relax_loads = true;
+	string loads_file;
+	if (check_fixture(dir, "api-loads", check_params(0x8000, 8), loads, loads_file) && file_read(loads_file, expected))
+	{
+		status = check_api(elf, DINO_RELAX_LOADS, NULL, dll, bss, diag);
+		check(status == 0 && dll == expected, "api: DINO_RELAX_LOADS matches --relax-loads", diag);
+	}
+
+	// a failure keeps no bytes and says why
+	vector<u8> garbage(elf.begin(), elf.begin() + 0x40);
+	garbage[0] = 0;
+	status = check_api(garbage, 0, NULL, dll, bss, diag);
+	check(status == 1 && dll.empty() && contains(diag, "not a valid ELF file"), "api: a broken object gives status 1 and a diagnostic", diag);
+
+	string profile = dir + "/api.missing.prof";
+	status = check_api(elf, 0, profile.c_str(), dll, bss, diag);
+	check(status == 1 && dll.empty() && contains(diag, "Unable to open profile " + profile), "api: a missing profile gives status 1 and a diagnostic", diag);
+
+	dino_result* result = dino_convert(NULL, NULL, 0, 0, NULL);
+	size_t size = 1;
+	check(result && dino_result_status(result) == 1 && !dino_result_dll(result, &size) && size == 0 &&
+		!strcmp(dino_result_diag(result), "No ELF objects to convert.\n"), "api: no objects gives status 1 and a diagnostic");
+	dino_result_free(result);
+
+	check(dino_result_status(NULL) == 1 && !strcmp(dino_result_diag(NULL), "") && dino_result_bss(NULL) == 0, "api: a NULL result reads as a failure");
+}
+
+int main(int argc, const char* argv[])
+{
+	if (argc != 2)
+	{
+		cerr << "Usage: " << argv[0] << " <output-dir>" << endl;
+		return 1;
+	}
+
+	string dir = argv[1];
+
+	check_gotable(dir);
+	check_merged(dir);
+	check_dll2elf(dir);
+	check_loader(dir);
+	check_verify(dir);
+	check_library(dir);
+
+	cout << checked - failed << " of " << checked << " checks passed." << endl;
+	return failed ? 1 : 0;
+}
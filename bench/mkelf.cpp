@@ -0,0 +1,83 @@
+// writes a synthetic MIPS relocatable object for benchmarking elf2dll
+
+#include "synth.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+static int usage(const char* argv0)
+{
+	cerr << "Usage: " << argv0 << " [options] <output-elf>" << endl;
+	cerr << endl;
+	cerr << "Options:" << endl;
+	cerr << "  --dll-size <n>  scale all counts to roughly an n byte DLL" << endl;
+	cerr << "  --text <n>      .text size in bytes" << endl;
+	cerr << "  --got16 <n>     R_MIPS_GOT16 relocations" << endl;
+	cerr << "  --call16 <n>    R_MIPS_CALL16 relocations" << endl;
+	cerr << "  --gp-disp <n>   functions with a _gp_disp stub" << endl;
+	cerr << "  --data32 <n>    R_MIPS_32 relocations in .data" << endl;
+	cerr << "  --gprel32 <n>   R_MIPS_GPREL32 relocations in .rodata" << endl;
+	cerr << "  --rodata <n>    .rodata size in bytes, 0 for an empty one" << endl;
+	cerr << "  --exports <n>   export table entries" << endl;
+	cerr << "  --seed <n>      random seed" << endl;
+	return 1;
+}
+
+int main(int argc, const char* argv[])
+{
+	synth_params params;
+	memset(&params, 0, sizeof(params));
+	synth_scale(params, 0x800);
+
+	string elf_file;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool more = i + 1 < argc;
+		u32 value = more ? (u32) strtoul(argv[i + 1], NULL, 0) : 0;
+
+		if (!strcmp(argv[i], "--dll-size") && more)
+			synth_scale(params, value);
+		else if (!strcmp(argv[i], "--text") && more)
+			params.text_size = value;
+		else if (!strcmp(argv[i], "--got16") && more)
+			params.got16 = value;
+		else if (!strcmp(argv[i], "--call16") && more)
+			params.call16 = value;
+		else if (!strcmp(argv[i], "--gp-disp") && more)
+			params.gp_disp = value;
+		else if (!strcmp(argv[i], "--data32") && more)
+			params.data32 = value;
+		else if (!strcmp(argv[i], "--gprel32") && more)
+			params.gprel32 = value;
+		else if (!strcmp(argv[i], "--rodata") && more)
+			params.rodata_size = value;
+		else if (!strcmp(argv[i], "--exports") && more)
+			params.exports = value;
+		else if (!strcmp(argv[i], "--seed") && more)
+			params.seed = value;
+		else if (!strncmp(argv[i], "--", 2) || !elf_file.empty())
+			return usage(argv[0]);
+		else
+		{
+			elf_file = argv[i];
+			continue;
+		}
+
+		i++;
+	}
+
+	if (elf_file.empty())
+		return usage(argv[0]);
+
+	if (!synth_write(params, elf_file))
+	{
+		cerr << "Unable to write " << elf_file << "." << endl;
+		return 1;
+	}
+
+	return 0;
+}
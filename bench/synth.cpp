@@ -0,0 +1,254 @@
+#include "synth.hpp"
+
+#include <elfio/elfio.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "elf2dll.hpp"
+#include "utils.h"
+
+using namespace std;
+using namespace ELFIO;
+
+#define MIPS_LW_V0_GP     (0x8F820000)
+#define MIPS_ADDIU_V0_V0  (0x24420000)
+#define MIPS_LW_T9_GP     (0x8F990000)
+#define MIPS_JALR_T9      (0x0320F809)
+#define MIPS_JR_RA        (0x03E00008)
+
+#define SYNTH_RODATA      (0x100u)
+#define SYNTH_DATA        (0x100u)
+#define SYNTH_BSS         (0x200u)
+
+typedef struct {
+	u32 offset;
+	u32 symbol;
+	u8 type;
+} synth_reloc;
+
+static u32 synth_random(u32& state)
+{
+	// xorshift32
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// scale every count to roughly fill a DLL of the given size
+u32 synth_scale(synth_params& params, u32 dll_size)
+{
+	u32 words = max(dll_size / 4, 64u);
+
+	params.text_size = words * 3;
+	// every function takes a GOT slot, keep them addressable by a 16-bit offset
+	params.gp_disp = min(max(words / 64, 2u), 4096u);
+	params.got16 = words / 16;
+	params.call16 = words / 16;
+	params.data32 = max(words / 128, 1u);
+	params.gprel32 = max(words / 256, 1u);
+	params.rodata_size = SYNTH_RODATA;
+	params.exports = min(max(params.gp_disp / 4, 2u), 1024u);
+
+	return params.text_size;
+}
+
+static void synth_words(vector<u8>& buffer, u32 offset, u32 word)
+{
+	if (buffer.size() < offset + 4)
+		buffer.resize(offset + 4, 0);
+
+	putbe32(&buffer[offset], word);
+}
+
+bool synth_write(const synth_params& params, const string& elf_file)
+{
+	u32 state = params.seed ? params.seed : 0xD1A0;
+	u32 functions = max(max(params.gp_disp, params.exports), 2u);
+
+	vector<u8> text, rodata, data, exports;
+	vector<synth_reloc> reltext, relrodata, reldata, relexports;
+	vector<u32> starts(functions);
+
+	// symbols: null, four section symbols, then the global functions and _gp_disp
+	const u32 sym_text = 1, sym_rodata = 2, sym_data = 3, sym_bss = 4;
+	const u32 sym_function = 5;
+	const u32 sym_gp_disp = sym_function + functions;
+
+	u32 rodata_size = max(params.rodata_size, params.gprel32 * 4);
+	u32 data_size = max(SYNTH_DATA, params.data32 * 4);
+
+	// an empty .rodata has nothing to point into
+	const u32 sym_first = rodata_size ? sym_rodata : sym_data;
+
+	u32 pos = 0;
+	for (u32 f = 0; f < functions; f++)
+	{
+		starts[f] = pos;
+
+		if (f < params.gp_disp)
+		{
+			reltext.push_back({ pos + 0, sym_gp_disp, R_MIPS_HI16 });
+			reltext.push_back({ pos + 4, sym_gp_disp, R_MIPS_LO16 });
+			synth_words(text, pos + 0, MIPS_LUI_GP_I16);
+			synth_words(text, pos + 4, MIPS_ADDIU_GP_I16);
+			synth_words(text, pos + 8, MIPS_ADDU_GP_T9);
+			pos += 12;
+		}
+
+		u32 got16 = (u32) ((u64) params.got16 * (f + 1) / functions - (u64) params.got16 * f / functions);
+		u32 call16 = (u32) ((u64) params.call16 * (f + 1) / functions - (u64) params.call16 * f / functions);
+
+		for (u32 i = 0; i < got16; i++)
+		{
+			u32 target = sym_first + synth_random(state) % (sym_bss - sym_first + 1);
+			u32 limit = target == sym_rodata ? rodata_size : target == sym_data ? data_size : SYNTH_BSS;
+			u32 addend = (synth_random(state) % (limit / 4)) * 4;
+
+			reltext.push_back({ pos + 0, target, R_MIPS_GOT16 });
+			reltext.push_back({ pos + 4, target, R_MIPS_LO16 });
+			synth_words(text, pos + 0, MIPS_LW_V0_GP);
+			synth_words(text, pos + 4, MIPS_ADDIU_V0_V0 | addend);
+			pos += 8;
+		}
+
+		for (u32 i = 0; i < call16; i++)
+		{
+			u32 callee = sym_function + synth_random(state) % functions;
+
+			reltext.push_back({ pos + 0, callee, R_MIPS_CALL16 });
+			reltext.push_back({ pos + 4, callee, R_MIPS_JALR });
+			synth_words(text, pos + 0, MIPS_LW_T9_GP);
+			synth_words(text, pos + 4, MIPS_JALR_T9);
+			synth_words(text, pos + 8, MIPS_NOP);
+			pos += 12;
+		}
+
+		synth_words(text, pos + 0, MIPS_JR_RA);
+		synth_words(text, pos + 4, MIPS_NOP);
+		pos += 8;
+	}
+
+	// pad the last function out to the requested size
+	if (text.size() < params.text_size)
+		text.resize(params.text_size & ~3u, 0);
+
+	rodata.resize(rodata_size, 0);
+	for (u32 i = 0; i < params.gprel32; i++)
+	{
+		u32 target = starts[synth_random(state) % functions];
+		relrodata.push_back({ i * 4, sym_text, R_MIPS_GPREL32 });
+		putbe32(&rodata[i * 4], target);
+	}
+
+	data.resize(data_size, 0);
+	for (u32 i = 0; i < params.data32; i++)
+	{
+		u32 target = synth_random(state) & 1 ? sym_first : sym_data;
+		u32 limit = target == sym_rodata ? rodata_size : data_size;
+		reldata.push_back({ i * 4, target, R_MIPS_32 });
+		putbe32(&data[i * 4], (synth_random(state) % (limit / 4)) * 4);
+	}
+
+	u32 count = max(params.exports, 2u);
+	exports.resize(count * 4, 0);
+	for (u32 i = 0; i < count; i++)
+		relexports.push_back({ i * 4, sym_function + (i % functions), R_MIPS_32 });
+
+	elfio elf;
+	elf.create(ELFCLASS32, ELFDATA2MSB);
+	elf.set_os_abi(ELFOSABI_NONE);
+	elf.set_type(ET_REL);
+	elf.set_machine(EM_MIPS);
+	elf.set_flags(0x10000007); // mips2, pic, cpic, noreorder
+
+	section* sec_text = elf.sections.add(".text");
+	sec_text->set_type(SHT_PROGBITS);
+	sec_text->set_flags(SHF_ALLOC | SHF_EXECINSTR);
+	sec_text->set_addr_align(16);
+	sec_text->set_data((const char*) &text[0], (Elf_Word) text.size());
+
+	section* sec_rodata = elf.sections.add(".rodata");
+	sec_rodata->set_type(SHT_PROGBITS);
+	sec_rodata->set_flags(SHF_ALLOC);
+	sec_rodata->set_addr_align(16);
+	sec_rodata->set_data(rodata.empty() ? NULL : (const char*) &rodata[0], (Elf_Word) rodata.size());
+
+	section* sec_data = elf.sections.add(".data");
+	sec_data->set_type(SHT_PROGBITS);
+	sec_data->set_flags(SHF_ALLOC | SHF_WRITE);
+	sec_data->set_addr_align(16);
+	sec_data->set_data((const char*) &data[0], (Elf_Word) data.size());
+
+	section* sec_bss = elf.sections.add(".bss");
+	sec_bss->set_type(SHT_NOBITS);
+	sec_bss->set_flags(SHF_ALLOC | SHF_WRITE);
+	sec_bss->set_addr_align(16);
+	sec_bss->set_size(SYNTH_BSS);
+
+	section* sec_exports = elf.sections.add(".exports");
+	sec_exports->set_type(SHT_PROGBITS);
+	sec_exports->set_flags(SHF_ALLOC);
+	sec_exports->set_addr_align(4);
+	sec_exports->set_data((const char*) &exports[0], (Elf_Word) exports.size());
+
+	section* sec_strtab = elf.sections.add(".strtab");
+	sec_strtab->set_type(SHT_STRTAB);
+	sec_strtab->set_addr_align(1);
+
+	section* sec_symtab = elf.sections.add(".symtab");
+	sec_symtab->set_type(SHT_SYMTAB);
+	sec_symtab->set_addr_align(4);
+	sec_symtab->set_entry_size(elf.get_default_entry_size(SHT_SYMTAB));
+	sec_symtab->set_link(sec_strtab->get_index());
+	sec_symtab->set_info(sym_function);
+
+	string_section_accessor strings(sec_strtab);
+	symbol_section_accessor symbols(elf, sec_symtab);
+
+	symbols.add_symbol(strings, "", 0, 0, STB_LOCAL, STT_SECTION, STV_DEFAULT, sec_text->get_index());
+	symbols.add_symbol(strings, "", 0, 0, STB_LOCAL, STT_SECTION, STV_DEFAULT, sec_rodata->get_index());
+	symbols.add_symbol(strings, "", 0, 0, STB_LOCAL, STT_SECTION, STV_DEFAULT, sec_data->get_index());
+	symbols.add_symbol(strings, "", 0, 0, STB_LOCAL, STT_SECTION, STV_DEFAULT, sec_bss->get_index());
+
+	for (u32 f = 0; f < functions; f++)
+	{
+		string name = "f" + to_string(f);
+		u32 end = f + 1 < functions ? starts[f + 1] : (u32) text.size();
+		symbols.add_symbol(strings, name.c_str(), starts[f], end - starts[f], STB_GLOBAL, STT_FUNC, STV_DEFAULT, sec_text->get_index());
+	}
+
+	symbols.add_symbol(strings, "_gp_disp", 0, 0, STB_GLOBAL, STT_NOTYPE, STV_DEFAULT, SHN_UNDEF);
+
+	const struct {
+		const char* name;
+		section* target;
+		vector<synth_reloc>* relocs;
+	} rels[] = {
+		{ ".rel.text", sec_text, &reltext },
+		{ ".rel.rodata", sec_rodata, &relrodata },
+		{ ".rel.data", sec_data, &reldata },
+		{ ".rel.exports", sec_exports, &relexports },
+	};
+
+	for (size_t r = 0; r < sizeof(rels) / sizeof(rels[0]); r++)
+	{
+		if (rels[r].relocs->empty()) continue;
+
+		section* sec = elf.sections.add(rels[r].name);
+		sec->set_type(SHT_REL);
+		sec->set_info(rels[r].target->get_index());
+		sec->set_link(sec_symtab->get_index());
+		sec->set_addr_align(4);
+		sec->set_entry_size(elf.get_default_entry_size(SHT_REL));
+
+		relocation_section_accessor accessor(elf, sec);
+		for (size_t i = 0; i < rels[r].relocs->size(); i++)
+		{
+			const synth_reloc& rel = (*rels[r].relocs)[i];
+			accessor.add_entry(rel.offset, rel.symbol, rel.type);
+		}
+	}
+
+	return elf.save(elf_file);
+}
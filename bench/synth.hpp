@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include "types.h"
+
+using namespace std;
+
+// shape of a synthetic big-endian MIPS relocatable object, counts are
+// relocations unless noted otherwise
+typedef struct {
+	u32 text_size;   // bytes, grown if the relocation sites need more
+	u32 got16;       // R_MIPS_GOT16 + R_MIPS_LO16 pairs against local data
+	u32 call16;      // R_MIPS_CALL16 + R_MIPS_JALR pairs between functions
+	u32 gp_disp;     // functions starting with a _gp_disp HI16/LO16 stub
+	u32 data32;      // R_MIPS_32 words in .data
+	u32 gprel32;     // R_MIPS_GPREL32 words in .rodata
+	u32 rodata_size; // bytes, grown for the GPREL32 words, 0 leaves .rodata empty
+	u32 exports;     // .exports entries, including constructor/destructor
+	u32 seed;
+} synth_params;
+
+bool synth_write(const synth_params& params, const string& elf_file);
+u32 synth_scale(synth_params& params, u32 dll_size);
@@ -0,0 +1,610 @@
+#include "batch.hpp"
+#include "elf2dll.hpp"
+#include "dll2elf.hpp"
+#include "loader.hpp"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <algorithm>
+
+#include "utils.h"
+#include "fileio.hpp"
+
+using namespace std;
+
+struct dino_queue {
+	mutex lock;
+	deque<size_t> jobs;
+};
+
+dino_pool::dino_pool(unsigned threads)
+{
+	if (threads == 0)
+		threads = thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+
+	this->threads = threads;
+}
+
+static bool pool_pop(dino_queue& queue, size_t& job)
+{
+	lock_guard<mutex> guard(queue.lock);
+	if (queue.jobs.empty()) return false;
+
+	job = queue.jobs.back();
+	queue.jobs.pop_back();
+	return true;
+}
+
+static bool pool_steal(dino_queue& queue, size_t& job)
+{
+	lock_guard<mutex> guard(queue.lock);
+	if (queue.jobs.empty()) return false;
+
+	job = queue.jobs.front();
+	queue.jobs.pop_front();
+	return true;
+}
+
+void dino_pool::run(const vector<size_t>& order, function<void(size_t)> job)
+{
+	run(order, [&job](size_t i, unsigned)
+	{
+		job(i);
+	});
+}
+
+void dino_pool::run(const vector<size_t>& order, function<void(size_t, unsigned)> job)
+{
+	unsigned workers = (unsigned) min<size_t>(threads, order.size());
+	if (workers <= 1)
+	{
+		for (size_t i = 0; i < order.size(); i++)
+			job(order[i], 0);
+		return;
+	}
+
+	// deal jobs out round robin onto the front of each deque; a worker pops
+	// its own from the back, so worker w starts on order[w] and goes through
+	// its share in order, while thieves take the tail of order from the front
+	vector<dino_queue> queues(workers);
+	for (size_t i = 0; i < order.size(); i++)
+		queues[i % workers].jobs.push_front(order[i]);
+
+	vector<thread> pool;
+	for (unsigned w = 0; w < workers; w++)
+	{
+		pool.push_back(thread([&queues, &job, workers, w]()
+		{
+			size_t next = 0;
+
+			for (;;)
+			{
+				bool found = pool_pop(queues[w], next);
+
+				for (unsigned v = 1; v < workers && !found; v++)
+					found = pool_steal(queues[(w + v) % workers], next);
+
+				// jobs never spawn jobs, so empty deques everywhere means done
+				if (!found) break;
+
+				job(next, w);
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+}
+
+bool batch_manifest(string manifest_file, vector<dino_job>& jobs, bool outputs)
+{
+	ifstream manifest(manifest_file.c_str());
+	if (!manifest)
+	{
+		cerr << "Unable to open manifest " << manifest_file << "." << endl;
+		return false;
+	}
+
+	string line;
+	int number = 0;
+
+	while (getline(manifest, line))
+	{
+		number++;
+
+		size_t comment = line.find('#');
+		if (comment != string::npos) line.erase(comment);
+
+		istringstream fields(line);
+		dino_job job;
+		string field;
+
+		// the last field names the output, every one before it an input
+		while (fields >> field)
+			job.elf_files.push_back(field);
+
+		if (job.elf_files.empty()) continue;
+
+		// a bundle names its outputs once, on the command line
+		if (outputs)
+		{
+			if (job.elf_files.size() < 2)
+			{
+				cerr << manifest_file << ":" << number << ": expected <input-elf>... <output-dll>." << endl;
+				return false;
+			}
+
+			job.dll_file = job.elf_files.back();
+			job.elf_files.pop_back();
+		}
+
+		jobs.push_back(job);
+	}
+
+	return true;
+}
+
+static u64 batch_weight(const vector<string>& files)
+{
+	u64 weight = 0;
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		ifstream stream(files[i].c_str(), ios::in | ios::binary | ios::ate);
+		if (stream) weight += (u64) stream.tellg();
+	}
+
+	return weight;
+}
+
+int batch_build(const vector<dino_job>& jobs, const dino_options& options, unsigned threads)
+{
+	vector<ostringstream> diags(jobs.size());
+	vector<dino_stats> stats(jobs.size());
+	vector<int> results(jobs.size(), 1);
+
+	// start the largest inputs first, stealing evens out the tail
+	vector<u64> weights(jobs.size());
+	vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		weights[i] = batch_weight(jobs[i].elf_files);
+		order[i] = i;
+	}
+
+	stable_sort(order.begin(), order.end(), [&weights](size_t a, size_t b)
+	{
+		return weights[a] > weights[b];
+	});
+
+	dino_pool pool(threads);
+	pool.run(order, [&jobs, &options, &diags, &stats, &results](size_t i)
+	{
+		dino_dll dll(options, diags[i]);
+		results[i] = dll.build(jobs[i].elf_files, jobs[i].dll_file);
+		stats[i] = dll.get_stats();
+	});
+
+	int failed = 0;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		string diag = diags[i].str();
+		if (!diag.empty())
+			cerr << jobs[i].elf_files[0] << ":" << endl << diag;
+
+		if (results[i] != 0)
+			failed++;
+	}
+
+	stats_print_all(cout, stats, options.stats);
+
+	if (failed)
+	{
+		cerr << failed << " of " << jobs.size() << " conversions failed." << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+// exclusive prefix sum, each worker scans its own run of sizes, then adds the
+// total of the runs before it
+static u64 batch_offsets(const vector<u64>& sizes, vector<u64>& offsets, dino_pool& pool)
+{
+	size_t count = sizes.size();
+	size_t runs = max<size_t>(1, min<size_t>(pool.size(), count));
+
+	offsets.assign(count, 0);
+
+	vector<u64> totals(runs, 0);
+	vector<size_t> order(runs);
+	for (size_t r = 0; r < runs; r++)
+		order[r] = r;
+
+	pool.run(order, [&](size_t r)
+	{
+		u64 sum = 0;
+		for (size_t i = count * r / runs; i < count * (r + 1) / runs; i++)
+		{
+			offsets[i] = sum;
+			sum += sizes[i];
+		}
+
+		totals[r] = sum;
+	});
+
+	vector<u64> bases(runs, 0);
+	for (size_t r = 1; r < runs; r++)
+		bases[r] = bases[r - 1] + totals[r - 1];
+
+	pool.run(order, [&](size_t r)
+	{
+		for (size_t i = count * r / runs; i < count * (r + 1) / runs; i++)
+			offsets[i] += bases[r];
+	});
+
+	return bases[runs - 1] + totals[runs - 1];
+}
+
+int batch_bundle(const vector<dino_job>& jobs, const dino_options& options, unsigned threads, string bank_file, string index_file)
+{
+	vector<ostringstream> diags(jobs.size());
+	vector<dino_stats> stats(jobs.size());
+	vector<int> results(jobs.size(), 1);
+	vector<vector<u8> > images(jobs.size());
+	vector<u32> bss(jobs.size(), 0);
+
+	vector<u64> weights(jobs.size());
+	vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		weights[i] = batch_weight(jobs[i].elf_files);
+		order[i] = i;
+	}
+
+	stable_sort(order.begin(), order.end(), [&weights](size_t a, size_t b)
+	{
+		return weights[a] > weights[b];
+	});
+
+	dino_pool pool(threads);
+	pool.run(order, [&](size_t i)
+	{
+		dino_dll dll(options, diags[i]);
+		results[i] = dll.build(jobs[i].elf_files, images[i], bss[i]);
+		stats[i] = dll.get_stats();
+		stats[i].dll_file = bank_file;
+	});
+
+	int failed = 0;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		string diag = diags[i].str();
+		if (!diag.empty())
+			cerr << jobs[i].elf_files[0] << ":" << endl << diag;
+
+		if (results[i] != 0)
+			failed++;
+	}
+
+	stats_print_all(cout, stats, options.stats);
+
+	// a bank with a hole in it is no use to anyone
+	if (failed)
+	{
+		cerr << failed << " of " << jobs.size() << " conversions failed, " << bank_file << " not written." << endl;
+		return 1;
+	}
+
+	vector<u64> sizes(jobs.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+		sizes[i] = images[i].size();
+
+	vector<u64> offsets;
+	u64 total = batch_offsets(sizes, offsets, pool);
+
+	if (total > 0xFFFFFFFFull)
+	{
+		cerr << bank_file << " would outgrow the 32-bit offsets of its index." << endl;
+		return 1;
+	}
+
+	// every DLL lands at its final place at once, no one waits on another
+	file_output output;
+	vector<u8> fallback;
+
+	u8* bank = output.open(bank_file, (size_t) total);
+	if (!bank)
+	{
+		fallback.assign((size_t) total, 0);
+		bank = fallback.empty() ? NULL : &fallback[0];
+	}
+
+	vector<size_t> all(jobs.size());
+	for (size_t i = 0; i < jobs.size(); i++)
+		all[i] = i;
+
+	pool.run(all, [&](size_t i)
+	{
+		if (!images[i].empty())
+			memcpy(bank + offsets[i], &images[i][0], images[i].size());
+	});
+
+	bool written = output.mapped() ? output.commit() : file_update(bank_file, bank, (size_t) total);
+	if (!written)
+	{
+		cerr << "Unable to write " << bank_file << "." << endl;
+		return 1;
+	}
+
+	vector<u8> index((jobs.size() + 2) * 2 * sizeof(u32));
+	u8* entry = index.empty() ? NULL : &index[0];
+
+	for (size_t i = 0; i <= jobs.size(); i++, entry += 2 * sizeof(u32))
+	{
+		putbe32(entry, (u32) (i < jobs.size() ? offsets[i] : total));
+		putbe32(entry + sizeof(u32), i < jobs.size() ? bss[i] : 0);
+	}
+
+	putbe32(entry, DINO_NONE);
+	putbe32(entry + sizeof(u32), DINO_NONE);
+
+	if (!file_update(index_file, &index[0], index.size()))
+	{
+		cerr << "Unable to write " << index_file << "." << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+// every job writes one ELF from one image, diagnostics come out in job order
+static int batch_unpack(const vector<string>& names, const vector<string>& elf_files, function<int(size_t, dino_elf&)> job, unsigned threads)
+{
+	vector<ostringstream> diags(elf_files.size());
+	vector<int> results(elf_files.size(), 1);
+
+	vector<size_t> order(elf_files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	dino_pool pool(threads);
+	pool.run(order, [&](size_t i)
+	{
+		dino_elf elf(diags[i]);
+		results[i] = job(i, elf);
+	});
+
+	int failed = 0;
+	for (size_t i = 0; i < elf_files.size(); i++)
+	{
+		string diag = diags[i].str();
+		if (!diag.empty())
+			cerr << names[i] << ":" << endl << diag;
+
+		if (results[i] != 0)
+			failed++;
+	}
+
+	if (failed)
+	{
+		cerr << failed << " of " << elf_files.size() << " conversions failed." << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+int batch_dll2elf(const vector<dino_job>& jobs, unsigned threads)
+{
+	vector<string> dll_files, elf_files;
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (jobs[i].elf_files.size() != 1)
+		{
+			cerr << "Expected <input-dll> <output-elf>, got " << jobs[i].elf_files.size() << " inputs for " << jobs[i].dll_file << "." << endl;
+			return 1;
+		}
+
+		dll_files.push_back(jobs[i].elf_files[0]);
+		elf_files.push_back(jobs[i].dll_file);
+	}
+
+	return batch_unpack(dll_files, elf_files, [&](size_t i, dino_elf& elf)
+	{
+		return elf.build(dll_files[i], elf_files[i]);
+	}, threads);
+}
+
+// a bank and its index as batch_bundle wrote them, offsets ends with the bank size
+static bool bank_read(string bank_file, string index_file, vector<u8>& bank, vector<u32>& offsets, vector<u32>& bss)
+{
+	vector<u8> index;
+	if (!file_read(bank_file, bank) || !file_read(index_file, index))
+	{
+		cerr << "Unable to read " << bank_file << " and " << index_file << "." << endl;
+		return false;
+	}
+
+	// (offset, .bss size) pairs, the one after the last DLL holds the bank size
+	for (size_t pos = 0; pos + 2 * sizeof(u32) <= index.size(); pos += 2 * sizeof(u32))
+	{
+		u32 offset = getbe32(&index[pos]);
+		if (offset == DINO_NONE) break;
+
+		offsets.push_back(offset);
+		bss.push_back(getbe32(&index[pos + sizeof(u32)]));
+	}
+
+	if (offsets.empty() || offsets.back() != bank.size())
+	{
+		cerr << index_file << " doesn't describe " << bank_file << "." << endl;
+		return false;
+	}
+
+	for (size_t i = 0; i + 1 < offsets.size(); i++)
+	{
+		if (offsets[i] > offsets[i + 1])
+		{
+			cerr << index_file << ": DLL " << i << " ends before it starts." << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static string bank_name(string bank_file, size_t i)
+{
+	ostringstream name;
+	name << bank_file << "[" << i << "]";
+	return name.str();
+}
+
+int batch_unbundle(string bank_file, string index_file, string elf_dir, unsigned threads)
+{
+	vector<u8> bank;
+	vector<u32> offsets, bss;
+	if (!bank_read(bank_file, index_file, bank, offsets, bss))
+		return 1;
+
+	vector<string> names, elf_files;
+	for (size_t i = 0; i + 1 < offsets.size(); i++)
+	{
+		names.push_back(bank_name(bank_file, i));
+
+		ostringstream file;
+		file << elf_dir << "/" << setw(4) << setfill('0') << i << ".elf";
+		elf_files.push_back(file.str());
+	}
+
+	return batch_unpack(names, elf_files, [&](size_t i, dino_elf& elf)
+	{
+		const u8* image = bank.empty() ? NULL : &bank[0] + offsets[i];
+		return elf.build(image, offsets[i + 1] - offsets[i], bss[i], elf_files[i]);
+	}, threads);
+}
+
+// every job hands its worker's loader one image, the costliest loads are
+// listed first
+static int batch_load(const vector<string>& names, function<bool(size_t, dino_loader&, ostream&)> job, const dino_options& options, unsigned threads)
+{
+	vector<ostringstream> diags(names.size());
+	vector<dino_stats> stats(names.size());
+	vector<int> results(names.size(), 1);
+
+	vector<size_t> order(names.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	dino_pool pool(threads);
+
+	// one RDRAM per worker rather than per DLL, each loader only clears what
+	// the DLL before it covered, its diagnostics are handed on to the job's
+	vector<ostringstream> outs(pool.size());
+	vector<dino_loader> loaders;
+	for (unsigned w = 0; w < pool.size(); w++)
+		loaders.push_back(dino_loader(outs[w]));
+
+	pool.run(order, [&](size_t i, unsigned w)
+	{
+		results[i] = job(i, loaders[w], outs[w]) ? 0 : 1;
+		stats[i] = loaders[w].get_stats();
+		stats[i].elf_file = names[i];
+
+		diags[i] << outs[w].str();
+		outs[w].str("");
+	});
+
+	int failed = 0;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		string diag = diags[i].str();
+		if (!diag.empty())
+			cerr << names[i] << ":" << endl << diag;
+
+		if (results[i] != 0)
+			failed++;
+	}
+
+	stable_sort(order.begin(), order.end(), [&stats](size_t a, size_t b)
+	{
+		return stats[a].counter("estimated cycles") > stats[b].counter("estimated cycles");
+	});
+
+	if (options.stats != STATS_NONE)
+	{
+		vector<dino_stats> ranked(names.size());
+		for (size_t i = 0; i < order.size(); i++)
+			ranked[i] = stats[order[i]];
+
+		stats_print_all(cout, ranked, options.stats);
+	}
+	else
+	{
+		cout << right << setw(12) << "cycles" << setw(12) << "relocation" << setw(8) << "words" << setw(8) << "lines" << "  dll" << endl;
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const dino_stats& s = stats[order[i]];
+			cout << setw(12) << s.counter("estimated cycles") << setw(12) << s.counter("relocation cycles") <<
+				setw(8) << s.counter("words touched") << setw(8) << s.counter("lines touched") << "  " << s.elf_file << (s.result ? " (failed)" : "") << endl;
+		}
+	}
+
+	if (failed)
+	{
+		cerr << failed << " of " << names.size() << " DLLs failed to load." << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+int batch_simulate(const vector<string>& dll_files, const dino_options& options, unsigned threads)
+{
+	return batch_load(dll_files, [&](size_t i, dino_loader& loader, ostream& diag)
+	{
+		vector<u8> image;
+		if (!file_read(dll_files[i], image))
+		{
+			diag << "Unable to read " << dll_files[i] << "." << endl;
+			return false;
+		}
+
+		// the unofficial .bss size after the dtor, if the DLL carries one
+		u32 bss = 0;
+		if (image.size() >= sizeof(dino_dll_header) + 3 * sizeof(u32))
+		{
+			bss = getbe32(&image[sizeof(dino_dll_header) + 2 * sizeof(u32)]);
+			if (bss == DINO_NONE) bss = 0;
+		}
+
+		return loader.load(image.empty() ? NULL : &image[0], image.size(), bss);
+	}, options, threads);
+}
+
+int batch_simulate(string bank_file, string index_file, const dino_options& options, unsigned threads)
+{
+	vector<u8> bank;
+	vector<u32> offsets, bss;
+	if (!bank_read(bank_file, index_file, bank, offsets, bss))
+		return 1;
+
+	vector<string> names;
+	for (size_t i = 0; i + 1 < offsets.size(); i++)
+		names.push_back(bank_name(bank_file, i));
+
+	return batch_load(names, [&](size_t i, dino_loader& loader, ostream&)
+	{
+		const u8* image = bank.empty() ? NULL : &bank[0] + offsets[i];
+		return loader.load(image, offsets[i + 1] - offsets[i], bss[i]);
+	}, options, threads);
+}
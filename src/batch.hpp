@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "types.h"
+
+struct dino_options;
+
+using namespace std;
+
+typedef struct {
+	vector<string> elf_files;
+	string dll_file;
+} dino_job;
+
+// runs count independent jobs on a fixed set of workers; each worker drains
+// its own deque from the back and steals from the front of the others, and
+// a job may be told which worker runs it to keep state from job to job
+class dino_pool {
+public:
+	dino_pool(unsigned threads = 0);
+
+	void run(const vector<size_t>& order, function<void(size_t)> job);
+	void run(const vector<size_t>& order, function<void(size_t, unsigned)> job);
+	unsigned size(void) const { return threads; }
+
+private:
+	unsigned threads;
+};
+
+bool batch_manifest(string manifest_file, vector<dino_job>& jobs, bool outputs = true);
+int batch_build(const vector<dino_job>& jobs, const dino_options& options, unsigned threads);
+
+// every job becomes one DLL of the bank, in manifest order; the index holds
+// a big-endian (offset, .bss size) pair per DLL, then (bank size, 0) and a
+// (DINO_NONE, DINO_NONE) terminator, so each DLL spans up to the next offset
+int batch_bundle(const vector<dino_job>& jobs, const dino_options& options, unsigned threads, string bank_file, string index_file);
+
+// the reverse, manifest lines name "<input-dll> <output-elf>"
+int batch_dll2elf(const vector<dino_job>& jobs, unsigned threads);
+
+// takes a bank written by batch_bundle apart into <elf_dir>/<n>.elf, the
+// index supplies each .bss size
+int batch_unbundle(string bank_file, string index_file, string elf_dir, unsigned threads);
+
+// loads every DLL into a simulated RDRAM, checking its tables on the way,
+// and lists them by estimated load cost, the costliest first
+int batch_simulate(const vector<string>& dll_files, const dino_options& options, unsigned threads);
+int batch_simulate(string bank_file, string index_file, const dino_options& options, unsigned threads);
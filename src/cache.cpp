@@ -0,0 +1,66 @@
+#include "cache.hpp"
+#include "fileio.hpp"
+#include "elf2dll.hpp"
+
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+
+#include "utils.h"
+
+using namespace std;
+
+bool dino_cache::key(const vector<string>& elf_files, const string& options, string& key)
+{
+	ostringstream salt;
+	salt << "elf2dll/" << DINO_VERSION << "/" << options;
+	string seed = salt.str();
+
+	u64 hash = hash64((const u8*) seed.data(), seed.size(), 0);
+
+	// chained, so moving bytes from one object to the next changes the key
+	for (size_t i = 0; i < elf_files.size(); i++)
+	{
+		vector<u8> elf;
+		if (!file_read(elf_files[i], elf)) return false;
+
+		hash = hash64(elf.empty() ? NULL : &elf[0], elf.size(), hash);
+	}
+
+	ostringstream name;
+	name << hex << setw(16) << setfill('0') << hash;
+	key = name.str();
+
+	return true;
+}
+
+string dino_cache::path(const string& key)
+{
+	return dir + "/" + key + ".dll";
+}
+
+bool dino_cache::load(const string& key, vector<u8>& dll)
+{
+	return file_read(path(key), dll);
+}
+
+bool dino_cache::store(const string& key, const u8* dll, size_t size)
+{
+	// write aside and rename so concurrent readers never see a partial entry
+	string temp = file_temp(path(key));
+
+	if (!file_write(temp, dll, size))
+	{
+		remove(temp.c_str());
+		return false;
+	}
+
+	if (!file_rename(temp, path(key)))
+	{
+		// lost a race against another writer of the same entry
+		remove(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
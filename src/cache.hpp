@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+// content-addressed store of converted DLLs, keyed by a hash of the input
+// ELF bytes in order, the converter version and the options affecting the output
+class dino_cache {
+public:
+	dino_cache(string dir) : dir(dir) {}
+
+	bool enabled(void) const { return !dir.empty(); }
+
+	bool key(const vector<string>& elf_files, const string& options, string& key);
+	bool load(const string& key, vector<u8>& dll);
+	bool store(const string& key, const u8* dll, size_t size);
+
+private:
+	string dir;
+
+	string path(const string& key);
+};
@@ -0,0 +1,589 @@
+#include "dll2elf.hpp"
+#include "utils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+using namespace ELFIO;
+
+// mips2, noreorder, pic, cpic, as the game's own objects were built
+#define DINO_ELF_FLAGS    (0x10000007)
+
+#define MIPS_OP_ADDIU     (0x09)
+#define MIPS_OP_LW        (0x23)
+
+static const char* dino_elf_names[4] = { ".text", ".rodata", ".data", ".bss" };
+static const char* dino_elf_prefixes[4] = { "text", "rodata", "data", "bss" };
+
+int dino_elf::build(string dll_file, string elf_file, u32 bss)
+{
+	vector<u8> image;
+	if (!file_read(dll_file, image) || image.empty())
+	{
+		diag << "Unable to read " << dll_file << "." << endl;
+		return 1;
+	}
+
+	return build(&image[0], image.size(), bss, elf_file);
+}
+
+int dino_elf::build(const u8* image, size_t size, u32 bss, string elf_file)
+{
+	if (convert(image, size, bss))
+		return 1;
+
+	// elfio seeks around while saving, so it writes a file of its own
+	string temp = file_temp(elf_file);
+
+	if (!elf.save(temp) || !file_rename(temp, elf_file))
+	{
+		remove(temp.c_str());
+		diag << "Unable to write " << elf_file << "." << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+int dino_elf::convert(const u8* image, size_t size, u32 bss)
+{
+	dll = image;
+	dll_size = size;
+
+	if (!header_parse()) return 1;
+	if (!tables_parse()) return 1;
+	if (!sections_find(bss)) return 1;
+	if (!text_restore()) return 1;
+
+	elf.create(ELFCLASS32, ELFDATA2MSB);
+	elf.set_os_abi(ELFOSABI_NONE);
+	elf.set_type(ET_REL);
+	elf.set_machine(EM_MIPS);
+	elf.set_flags(DINO_ELF_FLAGS);
+
+	sections_build();
+
+	section* strtab = elf.sections.add(".strtab");
+	strtab->set_type(SHT_STRTAB);
+	strtab->set_addr_align(1);
+
+	section* symtab = elf.sections.add(".symtab");
+	symtab->set_type(SHT_SYMTAB);
+	symtab->set_addr_align(4);
+	symtab->set_entry_size(elf.get_default_entry_size(SHT_SYMTAB));
+	symtab->set_link(strtab->get_index());
+
+	symbols_build(symtab, strtab);
+	relocs_build(symtab);
+
+	return 0;
+}
+
+bool dino_elf::header_parse(void)
+{
+	if (dll_size < sizeof(dino_dll_header))
+	{
+		diag << "Not a DLL, " << dll_size << " bytes is shorter than its header." << endl;
+		return false;
+	}
+
+	const dino_dll_header* header = (const dino_dll_header*) dll;
+	header_size = getbe32(header->header_size);
+	data_offset = getbe32(header->data_offset);
+	table_offset = getbe32(header->rodata_offset);
+	export_count = (int) getbe16(header->export_count);
+
+	// ctor, dtor, an unused word, the exports and a closing zero
+	size_t exports_end = sizeof(dino_dll_header) + (export_count + 4) * sizeof(u32);
+
+	if (header_size < exports_end || header_size > dll_size || (header_size & 3) != 0)
+	{
+		diag << "Header size 0x" << hex << header_size << dec << " doesn't fit " << export_count << " exports." << endl;
+		return false;
+	}
+
+	if ((data_offset != DINO_NONE && (data_offset < header_size || data_offset > dll_size)) ||
+		(table_offset != DINO_NONE && (table_offset < header_size || table_offset > dll_size)))
+	{
+		diag << "Section offsets in the header point outside the DLL." << endl;
+		return false;
+	}
+
+	const u8* words = dll + sizeof(dino_dll_header);
+
+	exports.clear();
+	exports.push_back(getbe32(words + 0 * sizeof(u32)));
+	exports.push_back(getbe32(words + 1 * sizeof(u32)));
+
+	for (int i = 0; i < export_count; i++)
+		exports.push_back(getbe32(words + (3 + i) * sizeof(u32)));
+
+	return true;
+}
+
+bool dino_elf::table_read(size_t& offset, u32 end, vector<u32>& entries, const char* name)
+{
+	entries.clear();
+
+	for (; offset + sizeof(u32) <= dll_size; offset += sizeof(u32))
+	{
+		u32 entry = getbe32(dll + offset);
+		if (entry == end)
+		{
+			offset += sizeof(u32);
+			return true;
+		}
+
+		entries.push_back(entry);
+	}
+
+	diag << "The " << name << " table runs off the end of the DLL." << endl;
+	return false;
+}
+
+bool dino_elf::tables_parse(void)
+{
+	gotable.clear();
+	gptable.clear();
+	datable.clear();
+
+	rodata_offset = table_offset;
+	if (table_offset == DINO_NONE) return true;
+
+	// unused GOT slots read DINO_DATEND, never DINO_GOTEND
+	size_t offset = table_offset;
+	if (!table_read(offset, DINO_GOTEND, gotable, "GOT")) return false;
+	if (!table_read(offset, DINO_GPTEND, gptable, "$gp")) return false;
+	if (!table_read(offset, DINO_DATEND, datable, ".data")) return false;
+
+	// the end of the tables opens .rodata unless the GOT says otherwise
+	rodata_offset = offset;
+
+	return true;
+}
+
+bool dino_elf::sections_find(u32 bss)
+{
+	for (int j = 0; j < 4; j++)
+	{
+		present[j] = false;
+		bases[j] = 0;
+		sizes[j] = 0;
+	}
+
+	u32 end = (u32) (dll_size - header_size);
+
+	// .bss opens within the padding that ends the DLL
+	bases[3] = gotable.size() > 3 ? gotable[3] : end;
+	if (bases[3] > end)
+	{
+		diag << ".bss at 0x" << hex << bases[3] << dec << " starts past the end of the DLL." << endl;
+		return false;
+	}
+
+	end = bases[3];
+
+	u32 data = data_offset != DINO_NONE ? (u32) (data_offset - header_size) : end;
+
+	present[0] = true;
+	sizes[0] = table_offset != DINO_NONE ? (u32) (table_offset - header_size) : data;
+
+	// without a table there was no .rodata either
+	if (table_offset != DINO_NONE)
+	{
+		bases[1] = gotable.size() > 1 ? gotable[1] : (u32) (rodata_offset - header_size);
+
+		if (bases[1] < sizes[0] || bases[1] > data || data > end)
+		{
+			diag << ".rodata at 0x" << hex << bases[1] << dec << " overlaps the sections around it." << endl;
+			return false;
+		}
+
+		present[1] = true;
+		sizes[1] = data - bases[1];
+	}
+
+	if (data_offset != DINO_NONE)
+	{
+		present[2] = true;
+		bases[2] = data;
+		sizes[2] = end - data;
+	}
+
+	// without a size from the table, the unofficial one after the dtor
+	if (bss == DINO_NONE)
+	{
+		bss = getbe32(dll + sizeof(dino_dll_header) + 2 * sizeof(u32));
+		if (bss == 0) bss = DINO_NONE;
+		else if (bss == DINO_NONE) bss = 0;
+	}
+
+	// failing both, .bss reaches as far as the GOT does into it
+	bss_inferred = bss == DINO_NONE;
+	if (bss_inferred)
+	{
+		bss = 0;
+		for (size_t i = 4; i < gotable.size(); i++)
+		{
+			if (gotable[i] >= bases[3] && gotable[i] != DINO_DATEND)
+				bss = max(bss, align(gotable[i] - bases[3] + 1, sizeof(u32)));
+		}
+	}
+
+	present[3] = bss != 0;
+	sizes[3] = bss;
+
+	for (size_t i = 0; i < datable.size(); i++)
+	{
+		if (!present[2] || datable[i] > sizes[2] - sizeof(u32) || sizes[2] < sizeof(u32))
+		{
+			diag << ".data table entry " << i << " at 0x" << hex << datable[i] << dec << " is outside .data." << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// whether an instruction addresses memory from its rs register, or adds
+// an immediate to it as "addiu rt, $gp, %gp_rel(sym)" does
+static bool insn_offsets(u32 insn)
+{
+	switch (insn >> 26)
+	{
+		case MIPS_OP_ADDIU:
+		case 0x20: case 0x21: case 0x22: case MIPS_OP_LW: // lb, lh, lwl, lw
+		case 0x24: case 0x25: case 0x26:                  // lbu, lhu, lwr
+		case 0x28: case 0x29: case 0x2A: case 0x2B:       // sb, sh, swl, sw
+		case 0x2E:                                        // swr
+		case 0x31: case 0x35: case 0x39: case 0x3D:       // lwc1, ldc1, swc1, sdc1
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+// undoes what the converter left in .text and the loader would redo: the
+// $gp setups go back to what the compiler emitted, GOT loads and small data
+// accesses are collected
+bool dino_elf::text_restore(void)
+{
+	const u8* code = dll + header_size;
+	text.assign(code, code + sizes[0]);
+
+	stubs.clear();
+	loads.clear();
+	gprels.clear();
+
+	vector<u8> covered(text.size() / sizeof(u32), 0);
+	if (!stubs_restore(covered)) return false;
+
+	bool ret = true;
+
+	for (u32 offset = 0; offset + sizeof(u32) <= text.size(); offset += sizeof(u32))
+	{
+		u32 insn = getbe32(&text[offset]);
+		if (covered[offset / sizeof(u32)] || (insn & MIPS_RSMASK) != MIPS_RS(MIPS_GP) || !insn_offsets(insn)) continue;
+
+		ret = gp_access(offset, insn) && ret;
+	}
+
+	// relocations go out in slot order, so the GOT fills up the same way again
+	sort(loads.begin(), loads.end());
+
+	return ret;
+}
+
+// the converter keeps the "lui/addiu" of a setup and nops the "addu $gp, $t9"
+// of "_gp_disp", so a setup not followed by a nop was "__gnu_local_gp"; one
+// followed by a nop was "_gp_disp" only if the tables say it is entered
+// through $t9, as a function the GOT, the exports or .data point at
+bool dino_elf::stubs_restore(vector<u8>& covered)
+{
+	vector<u32> entries(exports.begin(), exports.end());
+
+	for (size_t i = 0; i < gotable.size(); i++)
+	{
+		if (gotable[i] != DINO_DATEND)
+			entries.push_back(gotable[i]);
+	}
+
+	for (size_t i = 0; i < datable.size(); i++)
+		entries.push_back(getbe32(dll + header_size + bases[2] + datable[i]) + bases[2]);
+
+	sort(entries.begin(), entries.end());
+
+	bool ret = true;
+
+	for (size_t i = 0; i < gptable.size(); i++)
+	{
+		u32 offset = gptable[i];
+		if ((size_t) offset + 2 * sizeof(u32) > text.size() || (offset & 3) != 0)
+		{
+			diag << "$gp table entry " << i << " at 0x" << hex << offset << dec << " is outside .text." << endl;
+			return false;
+		}
+
+		u8* buffer = &text[offset];
+		bool nop = (size_t) offset + 3 * sizeof(u32) <= text.size() && getbe32(buffer + sizeof(u32) * 2) == MIPS_NOP;
+		bool entered = binary_search(entries.begin(), entries.end(), offset);
+
+		if (nop && !entered)
+		{
+			diag << "$gp setup at .text+0x" << hex << offset << dec << " is followed by a nop, but nothing enters it through $t9 to tell \"_gp_disp\" from \"__gnu_local_gp\"." << endl;
+			ret = false;
+			continue;
+		}
+
+		u8 flavour = nop ? DINO_GP_DISP : DINO_GP_LOCAL;
+		size_t words = flavour == DINO_GP_DISP ? 3 : 2;
+
+		putbe32(buffer + sizeof(u32) * 0, MIPS_LUI_GP_I16);
+		putbe32(buffer + sizeof(u32) * 1, MIPS_ADDIU_GP_I16);
+		if (flavour == DINO_GP_DISP)
+			putbe32(buffer + sizeof(u32) * 2, MIPS_ADDU_GP_T9);
+
+		for (size_t w = 0; w < words; w++)
+			covered[offset / sizeof(u32) + w] = 1;
+
+		stubs.push_back(make_pair(offset, flavour));
+	}
+
+	return ret;
+}
+
+// $gp holds the GOT: a "lw" within it is a GOT load, whatever relocation
+// produced it, anything else has to land in small data past the tables
+bool dino_elf::gp_access(u32 offset, u32 insn)
+{
+	u32 got_size = (u32) (gotable.size() * sizeof(u32));
+	s32 displacement = (s16) (insn & MIPS_IMMMASK);
+
+	if (displacement >= 0 && (u32) displacement < got_size)
+	{
+		u32 slot = (u32) displacement / sizeof(u32);
+
+		if ((insn >> 26) != MIPS_OP_LW || (displacement & 3) != 0 || gotable[slot] == DINO_DATEND)
+		{
+			diag << "Instruction at .text+0x" << hex << offset << " reaches GOT+0x" << displacement << dec << ", which isn't a load of a used slot." << endl;
+			return false;
+		}
+
+		loads.push_back(make_pair(slot, offset));
+		putbe32(&text[offset], insn & ~MIPS_IMMMASK);
+		return true;
+	}
+
+	u32 address = (u32) (table_offset - header_size) + (u32) displacement;
+	int role = small_role(address);
+	s64 addend = role < 0 ? 0 : (s64) address - bases[role];
+
+	if (role < 0 || addend > 0x7FFF)
+	{
+		diag << "Instruction at .text+0x" << hex << offset << " reaches 0x" << address << dec << " from $gp, neither the GOT nor small data." << endl;
+		return false;
+	}
+
+	gprels.push_back(make_pair(offset, role));
+	putbe32(&text[offset], (insn & ~MIPS_IMMMASK) | (u32) addend);
+	return true;
+}
+
+void dino_elf::sections_build(void)
+{
+	for (int j = 0; j < 4; j++)
+	{
+		role_sections[j] = NULL;
+		if (!present[j]) continue;
+
+		section* sec = elf.sections.add(dino_elf_names[j]);
+		sec->set_addr_align(16);
+
+		switch (j)
+		{
+			case 0:
+				sec->set_type(SHT_PROGBITS);
+				sec->set_flags(SHF_ALLOC | SHF_EXECINSTR);
+				if (!text.empty()) sec->set_data((const char*) &text[0], (Elf_Word) text.size());
+				break;
+
+			case 1:
+			case 2:
+				sec->set_type(SHT_PROGBITS);
+				sec->set_flags(SHF_ALLOC | (j == 2 ? SHF_WRITE : 0));
+				if (sizes[j]) sec->set_data((const char*) dll + header_size + bases[j], sizes[j]);
+				break;
+
+			case 3:
+				sec->set_type(SHT_NOBITS);
+				sec->set_flags(SHF_ALLOC | SHF_WRITE);
+				sec->set_size(sizes[j]);
+				break;
+		}
+
+		role_sections[j] = sec;
+	}
+
+	// the exports hold symbols, the words themselves say nothing
+	vector<u8> words(exports.size() * sizeof(u32), 0);
+
+	section* sec = elf.sections.add(".exports");
+	sec->set_type(SHT_PROGBITS);
+	sec->set_flags(SHF_ALLOC);
+	sec->set_addr_align(4);
+	sec->set_data((const char*) &words[0], (Elf_Word) words.size());
+}
+
+// the last present section starting at or before address, a GOT page
+// may well point past the end of it
+int dino_elf::target_role(u32 address)
+{
+	int role = 0;
+
+	for (int j = 1; j < 4; j++)
+	{
+		if (present[j] && bases[j] <= address)
+			role = j;
+	}
+
+	return role;
+}
+
+// the data section holding address, -1 outside them; .bss of a guessed
+// size grows to whatever $gp reaches into it
+int dino_elf::small_role(u32 address)
+{
+	for (int j = 1; j < 4; j++)
+	{
+		if (!present[j] && !(j == 3 && bss_inferred)) continue;
+		if (address < bases[j]) continue;
+
+		if (j == 3 && bss_inferred && address - bases[j] >= sizes[j])
+		{
+			sizes[j] = align(address - bases[j] + 1, sizeof(u32));
+			present[j] = true;
+		}
+
+		if (address - bases[j] < sizes[j])
+			return j;
+	}
+
+	return -1;
+}
+
+void dino_elf::symbols_build(section* symtab, section* strtab)
+{
+	string_section_accessor strings(strtab);
+	symbol_section_accessor writer(elf, symtab);
+
+	for (int j = 0; j < 4; j++)
+	{
+		section_symbols[j] = 0;
+		if (role_sections[j])
+			section_symbols[j] = writer.add_symbol(strings, "", 0, 0, STB_LOCAL, STT_SECTION, STV_DEFAULT, role_sections[j]->get_index());
+	}
+
+	targets.clear();
+	for (size_t i = 0; i < loads.size(); i++)
+		targets[gotable[loads[i].first]] = 0;
+
+	char name[32];
+
+	for (map<u32, Elf_Word>::iterator it = targets.begin(); it != targets.end(); ++it)
+	{
+		int role = target_role(it->first);
+		u32 value = it->first - bases[role];
+
+		snprintf(name, sizeof(name), "%s_%x", dino_elf_prefixes[role], value);
+		it->second = writer.add_symbol(strings, name, value, 0, STB_LOCAL, role == 0 ? STT_FUNC : STT_NOTYPE, STV_DEFAULT, role_sections[role]->get_index());
+	}
+
+	symtab->set_info((Elf_Word) (symtab->get_size() / symtab->get_entry_size()));
+
+	// ctor and dtor open the exports, the rest are numbered as the game calls them
+	for (size_t i = 0; i < exports.size(); i++)
+	{
+		if (i < 2) snprintf(name, sizeof(name), "%s", i == 0 ? "dll_ctor" : "dll_dtor");
+		else snprintf(name, sizeof(name), "dll_export_%u", (unsigned) (i - 2));
+
+		writer.add_symbol(strings, name, exports[i], 0, STB_GLOBAL, STT_FUNC, STV_DEFAULT, role_sections[0]->get_index());
+	}
+
+	gp_symbols[DINO_GP_DISP] = gp_symbols[DINO_GP_LOCAL] = 0;
+
+	for (size_t i = 0; i < stubs.size(); i++)
+	{
+		u8 flavour = stubs[i].second;
+		if (!gp_symbols[flavour])
+			gp_symbols[flavour] = writer.add_symbol(strings, flavour == DINO_GP_DISP ? "_gp_disp" : "__gnu_local_gp", 0, 0, STB_GLOBAL, STT_NOTYPE, STV_DEFAULT, SHN_UNDEF);
+	}
+}
+
+section* dino_elf::relocs_section(int role, section* symtab)
+{
+	section* target = role < 0 ? elf.sections[".exports"] : role_sections[role];
+
+	section* sec = elf.sections.add(string(".rel") + target->get_name());
+	sec->set_type(SHT_REL);
+	sec->set_addr_align(4);
+	sec->set_entry_size(elf.get_default_entry_size(SHT_REL));
+	sec->set_link(symtab->get_index());
+	sec->set_info(target->get_index());
+
+	return sec;
+}
+
+void dino_elf::relocs_build(section* symtab)
+{
+	// the converter wants .rel.text and .rel.exports, even empty
+	relocation_section_accessor reltext(elf, relocs_section(0, symtab));
+
+	for (size_t i = 0; i < stubs.size(); i++)
+	{
+		Elf_Word symbol = gp_symbols[stubs[i].second];
+		reltext.add_entry(stubs[i].first, symbol, (unsigned char) R_MIPS_HI16);
+		reltext.add_entry(stubs[i].first + sizeof(u32), symbol, (unsigned char) R_MIPS_LO16);
+	}
+
+	for (size_t i = 0; i < loads.size(); i++)
+	{
+		u32 address = gotable[loads[i].first];
+		u32 offset = loads[i].second;
+		u32 rt = (getbe32(&text[offset]) & MIPS_RTMASK) >> 16;
+
+		bool call = rt == 25 && target_role(address) == 0;
+		reltext.add_entry(offset, targets[address], (unsigned char) (call ? R_MIPS_CALL16 : R_MIPS_GOT_DISP));
+	}
+
+	for (size_t i = 0; i < gprels.size(); i++)
+		reltext.add_entry(gprels[i].first, section_symbols[gprels[i].second], (unsigned char) R_MIPS_GPREL16);
+
+	// .data words hold offsets from .data, the addend goes back relative to its own section
+	if (present[2] && !datable.empty())
+	{
+		section* sec = role_sections[2];
+		relocation_section_accessor reldata(elf, relocs_section(2, symtab));
+
+		vector<u8> bytes(dll + header_size + bases[2], dll + header_size + bases[2] + sizes[2]);
+
+		for (size_t i = 0; i < datable.size(); i++)
+		{
+			u32 address = getbe32(&bytes[datable[i]]) + bases[2];
+			int role = target_role(address);
+
+			putbe32(&bytes[datable[i]], address - bases[role]);
+			reldata.add_entry(datable[i], section_symbols[role], (unsigned char) R_MIPS_32);
+		}
+
+		sec->set_data((const char*) &bytes[0], (Elf_Word) bytes.size());
+	}
+
+	relocation_section_accessor relexports(elf, relocs_section(-1, symtab));
+	Elf_Word first = symtab->get_info();
+
+	for (size_t i = 0; i < exports.size(); i++)
+		relexports.add_entry(i * sizeof(u32), first + (Elf_Word) i, (unsigned char) R_MIPS_32);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <elfio/elfio.hpp>
+#include <map>
+#include "types.h"
+#include "elf2dll.hpp"
+
+using namespace std;
+using namespace ELFIO;
+
+// a DLL taken back apart into a relocatable ELF: what the tables still say
+// becomes .rel.* entries against symbols named after their offsets, so the
+// result converts back into the same DLL
+class dino_elf {
+public:
+	dino_elf(ostream& diag = cerr) : diag(diag) {}
+
+	// bss is the .bss size from the DLL's table entry, DINO_NONE when unknown
+	int build(string dll_file, string elf_file, u32 bss = DINO_NONE);
+	int build(const u8* image, size_t size, u32 bss, string elf_file);
+	int convert(const u8* image, size_t size, u32 bss);
+
+private:
+	ostream& diag;
+	elfio elf;
+
+	const u8* dll;
+	size_t dll_size;
+	size_t header_size;
+	size_t table_offset;
+	size_t rodata_offset;
+	size_t data_offset;
+	int export_count;
+
+	// .text, .rodata, .data and .bss, relative to .text like every offset the DLL holds
+	bool present[4];
+	u32 bases[4];
+	u32 sizes[4];
+	bool bss_inferred;
+
+	vector<u32> exports;
+	vector<u32> gotable;
+	vector<u32> gptable;
+	vector<u32> datable;
+
+	vector<u8> text;
+
+	// GOT loads in .text as (slot, offset), gp setups as offset and flavour,
+	// small data reached from $gp as offset and role
+	vector<pair<u32, u32> > loads;
+	vector<pair<u32, u8> > stubs;
+	vector<pair<u32, int> > gprels;
+
+	section* role_sections[4];
+	Elf_Word section_symbols[4];
+	map<u32, Elf_Word> targets;
+	Elf_Word gp_symbols[3];
+
+	bool header_parse(void);
+	bool tables_parse(void);
+	bool table_read(size_t& offset, u32 end, vector<u32>& entries, const char* name);
+	bool sections_find(u32 bss);
+
+	bool text_restore(void);
+	bool stubs_restore(vector<u8>& covered);
+	bool gp_access(u32 offset, u32 insn);
+	void sections_build(void);
+	void symbols_build(section* symtab, section* strtab);
+	void relocs_build(section* symtab);
+
+	int target_role(u32 address);
+	int small_role(u32 address);
+	section* relocs_section(int role, section* symtab);
+};
@@ -4,10 +4,15 @@
 
 #include "elf2dll.hpp"
 
-#include <list>
 #include <algorithm>
+#include <map>
+#include <sstream>
+#include <cstring>
 
 #include "utils.h"
+#include "cache.hpp"
+#include "fileio.hpp"
+#include "link.hpp"
 
 #include <elfio/elfio_dump.hpp>
 
@@ -16,833 +21,2708 @@ using namespace ELFIO;
 
 //#define DINO_DEBUG
 
-int dino_dll::build(string elf_file, string dll_file)
+static const char* dino_role_names[ROLE_COUNT] = {
+	".text", ".rodata", ".data", ".bss",
+	".rel.text", ".rel.rodata", ".rel.data", ".rel.exports",
+	".symtab",
+};
+
+// -G small data joins the section of the same kind, ahead of everything
+// else in it so it stays within reach of $gp
+static const struct {
+	const char* name;
+	dino_role role;
+} dino_small_names[] = {
+	{ ".lit4", ROLE_RODATA },
+	{ ".lit8", ROLE_RODATA },
+	{ ".srdata", ROLE_RODATA },
+	{ ".sdata", ROLE_DATA },
+	{ ".sbss", ROLE_BSS },
+	{ ".rel.srdata", ROLE_RELRODATA },
+	{ ".rel.sdata", ROLE_RELDATA },
+};
+
+static bool name_matches(const string& name, const char* base, bool suffix)
 {
-	if (!elf.load(elf_file))
-	{
-		cerr << elf_file << " is not a valid ELF file." << endl;
-		return 1;
-	}
+	size_t length = strlen(base);
 
-	bool ret = true;
+	if (name.compare(0, length, base) != 0) return false;
+	if (name.size() == length) return true;
 
-	if (ret) ret = create();
+	return suffix && name[length] == '.';
+}
 
-	if (ret) ret = header_build();
-	if (ret) ret = sections_copy();
+// ".rela.text" and friends are the same roles as ".rel.text", with the
+// addends spelled out instead of stored in the bytes they apply to
+static string name_rel(const string& name)
+{
+	if (name.compare(0, 6, ".rela.") == 0) return ".rel." + name.substr(6);
 
-	if (ret) ret = exports_build();
-	if (ret) ret = gpstub_patch();
-	if (ret) ret = table_build();
+	return name;
+}
 
-#ifdef DINO_BSSHACK
-	if (ret) ret = exports_patch();
-#endif
+// sections named exactly after a role, never dropped or folded
+static bool name_plain(const string& name, dino_role role)
+{
+	if (name == dino_role_names[role]) return true;
 
-	if (!ret)
+	for (size_t i = 0; i < sizeof(dino_small_names) / sizeof(dino_small_names[0]); i++)
 	{
-		delete[] dll;
-		return 1;
+		if (dino_small_names[i].role == role && name == dino_small_names[i].name)
+			return true;
 	}
 
-	fstream out;
-	out.open(dll_file, ios::out | ios::binary);
-	out.write((char*) dll, dll_size);
-	out.close();
-
-	delete[] dll;
-
-#ifdef DINO_DEBUG
-	elf_dump();
-#endif
-
-	return 0;
+	return false;
 }
 
-bool dino_dll::create(void)
+string dino_options::key(void) const
 {
-	text_offset = 0;
-	rodata_offset = 0;
-	data_offset = 0;
-	bss_offset = 0;
+	string key;
 
-	if (section_by_name(".text"))
-		text_offset = (size_t) section_by_name(".text")->get_offset();
+#ifdef DINO_BSSHACK
+	key += "bsshack;";
+#endif
 
-	if (section_by_name(".rodata"))
-		rodata_offset = (size_t) section_by_name(".rodata")->get_offset();
+	if (relax_calls)
+		key += "relax-calls;";
 
-	if (section_by_name(".data"))
-		data_offset = (size_t) section_by_name(".data")->get_offset();
+	if (relax_loads)
+		key += "relax-loads;";
 
-	if (section_by_name(".bss"))
-		bss_offset = (size_t) section_by_name(".bss")->get_offset();
+	if (!gc_sections)
+		key += "no-gc-sections;";
 
-	gotable_number = 0;
+	if (fold_code)
+		key += "icf;";
 
-	dll_size = sizeof(dino_dll_header);
+	if (!merge_constants)
+		key += "no-merge-constants;";
 
-	exports_offset = dll_size;
-	dll_size += exports_size();
+	if (!profile_file.empty())
+		key += "profile=" + profile_key(profile_file) + ";";
 
-	header_size = dll_size;
+	return key;
+}
 
-	text_offset = dll_size;
-	dll_size += align(section_size(".text"), 16);
+int dino_dll::build(string elf_file, string dll_file)
+{
+	return build(vector<string>(1, elf_file), dll_file);
+}
 
-	table_offset = dll_size;
-	dll_size += table_size();
+int dino_dll::build(const vector<string>& elf_files, string dll_file)
+{
+	if (elf_files.empty()) return 1;
 
-	rodata_offset = dll_size;
-	dll_size += align(section_size(".rodata"), 16);
+	stats.reset(elf_files[0], dll_file);
+	stats.result = 1;
 
-	data_offset = dll_size;
-	dll_size += align(section_size(".data"), 16);
+	dino_cache cache(options.cache_dir);
+	string key;
 
-	bss_offset = dll_size;
-	dll_size = align(dll_size, 16);
+	// a hit never touches ELFIO
+	if (cache.enabled())
+	{
+		vector<u8> stored;
+		bool hit = false;
 
-	bss_size = 0; // jfc.
-	if (section_size(".bss") >= (dll_size - bss_offset))
-		bss_size = section_size(".bss") - (dll_size - bss_offset);
+		{
+			dino_timer timer(stats, "cache lookup");
+			hit = cache.key(elf_files, options.key(), key) && cache.load(key, stored);
+		}
 
-	dll = new u8[dll_size];
-	memset(dll, 0, dll_size);
+		stats.count("cache hits", hit);
 
-	header = (dino_dll_header*) dll;
-	exports = dll + exports_offset;
+		if (hit)
+		{
+			dino_timer timer(stats, "write");
+			if (!file_update(dll_file, stored.empty() ? NULL : &stored[0], stored.size()))
+			{
+				diag << "Unable to write " << dll_file << "." << endl;
+				return 1;
+			}
 
-	text = dll + text_offset;
-	if (!section_exists(".text")) text = NULL;
+			stats.count("dll size", stored.size());
+			stats.result = 0;
+			return 0;
+		}
+	}
 
-	rodata = dll + rodata_offset;
-	if (!section_exists(".rodata")) rodata = NULL;
+	output_file = dll_file;
+	int converted = convert(elf_files);
+	output_file.clear();
 
-	data = dll + data_offset;
-	if (!section_exists(".data")) data = NULL;
+	if (converted)
+		return 1;
 
-	table = dll + table_offset;
-	if (table_size() == 0) table = NULL;
+	// the mapping goes away on commit, so store first
+	if (!key.empty())
+	{
+		dino_timer timer(stats, "cache store");
+		cache.store(key, dll, dll_size);
+	}
 
-	if (table)
-		gp_offset = table_offset - header_size;
-	else if (rodata)
-		gp_offset = rodata_offset - header_size;
+	{
+		dino_timer timer(stats, "write");
 
-	return true;
-}
+		bool written = false;
+		if (output.mapped())
+		{
+			written = output.commit();
+			dll = NULL;
+		}
+		else
+			written = file_update(dll_file, dll, dll_size);
 
-size_t dino_dll::table_size(void)
-{
-	size_t size = DINO_TABMIN;
-	size += gotable_size();
-	size += gptable_size();
-	size += datable_size();
+		if (!written)
+		{
+			diag << "Unable to write " << dll_file << "." << endl;
+			return 1;
+		}
+	}
 
-	// don't insert a placeholder table if the rodata section doesn't exist
-	if (size == DINO_TABMIN && section_by_name(".rodata") == 0)
-		return 0;
+	stats.result = 0;
 
-	return size;
+#ifdef DINO_DEBUG
+	elf_dump();
+#endif
+
+	return 0;
 }
 
-bool dino_dll::table_build(void)
+int dino_dll::build(const vector<string>& elf_files, vector<u8>& image, u32& bss)
 {
-	bool ret = false;
-	if (!table) return true;
+	if (elf_files.empty()) return 1;
 
-	gotable = table;
-	u8* gotend = gotable + gotable_size();
-	putbe32(gotend, DINO_GOTEND);
+	stats.reset(elf_files[0], "");
+	stats.result = 1;
 
-	gptable = gotable + gotable_size() + sizeof(u32);
-	u8* gptend = gptable + gptable_size();
-	putbe32(gptend, DINO_GPTEND);
+	if (convert(elf_files))
+		return 1;
 
-	datable = gptable + gptable_size() + sizeof(u32);
-	u8* datend = datable + datable_size();
-	putbe32(datend, DINO_DATEND);
+	image.assign(dll, dll + dll_size);
+	bss = (u32) bss_size;
 
-	ret |= !gotable_build();
-	ret |= !gptable_build();
-	ret |= !datable_build();
-	ret |= !rotable_build();
+	dll_free();
+	stats.result = 0;
 
-	return !ret;
+	return 0;
 }
 
-bool dino_dll::header_build(void)
+int dino_dll::build(const vector<dino_span>& elf_images, vector<u8>& image, u32& bss)
 {
-	putbe32(header->header_size, header_size);
-	putbe32(header->data_offset, data ? data_offset : DINO_NONE);
-	putbe32(header->rodata_offset, table ? table_offset : DINO_NONE);
-	putbe16(header->export_count, exports_count());
-	putbe16(header->padding, 0);
+	stats.reset("", "");
+	stats.result = 1;
 
-	return true;
+	if (convert(elf_images))
+		return 1;
+
+	image.assign(dll, dll + dll_size);
+	bss = (u32) bss_size;
+
+	dll_free();
+	stats.result = 0;
+
+	return 0;
 }
 
-bool dino_dll::sections_copy(void)
+int dino_dll::convert(string elf_file)
 {
-	if (text) memcpy(text, section_data(".text"), section_size(".text"));
-	if (rodata) memcpy(rodata, section_data(".rodata"), section_size(".rodata"));
-	if (data) memcpy(data, section_data(".data"), section_size(".data"));
-
-	return true;
+	return convert(vector<string>(1, elf_file));
 }
 
-bool dino_dll::gpstub_patch(void)
+int dino_dll::convert(const vector<string>& elf_files)
 {
-	if (!text) return true;
+	if (elf_files.empty()) return 1;
 
-	section* sec_reltext = section_by_name(".rel.text");
-	if (!sec_reltext) return false;
+	// only the role sections and symbol names are ever read, leave
+	// .mdebug, .pdr, .comment and friends on disk
+	vector<string> needed(dino_role_names, dino_role_names + ROLE_COUNT);
+	for (int j = ROLE_RELTEXT; j <= ROLE_RELEXPORTS; j++)
+		needed.push_back(string(".rela.") + (dino_role_names[j] + 5));
+	needed.push_back(".strtab");
 
-	relocation_section_accessor reltext(elf, sec_reltext);
-	symbol_section_accessor symbols(elf, elf.sections[sec_reltext->get_link()]);
+	if (elf_files.size() == 1)
+	{
+		elf.set_prefetch(needed);
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+		bool loaded = false;
+		{
+			dino_timer timer(stats, "load");
+			loaded = elf.load_mapped(elf_files[0]);
+		}
 
-	for (unsigned int i = 0; i < reltext.get_entries_num(); i++)
+		if (!loaded)
+		{
+			diag << elf_files[0] << " is not a valid ELF file." << endl;
+			return 1;
+		}
+	}
+	else
 	{
-		reltext.get_entry(i, offset, symbol, type, addend);
-		symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+		dino_linker linker(diag);
+		bool loaded = true;
 
-		// replace "addiu $gp, $gp, #imm16" with "ori $gp, $gp, #imm16"
-		// nop the "addu $gp, $t9"
-		if (name == "_gp_disp" && type == R_MIPS_HI16)
 		{
-			u8* buffer = text + offset;
-
-			putbe32(buffer + sizeof(u32) * 0, MIPS_LUI_GP_I16);
-			putbe32(buffer + sizeof(u32) * 1, MIPS_ORI_GP_I16);
-			putbe32(buffer + sizeof(u32) * 2, MIPS_NOP);
+			dino_timer timer(stats, "load");
+			for (size_t i = 0; i < elf_files.size() && loaded; i++)
+				loaded = linker.load(elf_files[i], needed);
 		}
+
+		if (!loaded) return 1;
+
+		stats.count("objects linked", linker.size());
+
+		dino_timer timer(stats, "link");
+		if (!linker.link(elf, 0)) return 1;
 	}
-	
-	return true;
+
+	return convert_elf();
 }
 
-int dino_dll::gptable_count(void)
+// the ELF images stay with the caller, elfio reads its own copy out of them
+int dino_dll::convert(const vector<dino_span>& elf_images)
 {
-	section* sec_reltext = section_by_name(".rel.text");
-	if (!sec_reltext) return 0;
-
-	relocation_section_accessor reltext(elf, sec_reltext);
-	symbol_section_accessor symbols(elf, elf.sections[sec_reltext->get_link()]);
+	if (elf_images.empty()) return 1;
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+	if (elf_images.size() == 1)
+	{
+		memory_streambuf buffer((char*) elf_images[0].data, elf_images[0].size);
+		istream stream(&buffer);
 
-	int count = 0;
+		bool loaded = false;
+		{
+			dino_timer timer(stats, "load");
+			loaded = elf.load(stream);
+		}
 
-	for (unsigned int i = 0; i < reltext.get_entries_num(); i++)
+		if (!loaded)
+		{
+			diag << "The input is not a valid ELF file." << endl;
+			return 1;
+		}
+	}
+	else
 	{
-		reltext.get_entry(i, offset, symbol, type, addend);
-		symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+		dino_linker linker(diag);
+		bool loaded = true;
 
-		if (name == "_gp_disp" && type == R_MIPS_HI16)
-			count++;
+		{
+			dino_timer timer(stats, "load");
+			for (size_t i = 0; i < elf_images.size() && loaded; i++)
+				loaded = linker.load(elf_images[i].data, elf_images[i].size);
+		}
+
+		if (!loaded) return 1;
+
+		stats.count("objects linked", linker.size());
+
+		dino_timer timer(stats, "link");
+		if (!linker.link(elf, 0)) return 1;
 	}
 
-	return count;
+	return convert_elf();
 }
 
-size_t dino_dll::gptable_size(void)
+int dino_dll::convert_elf(void)
 {
-	return gptable_count() * sizeof(u32);
-}
+	bool ret = true;
 
-bool dino_dll::gptable_build(void)
-{
-	section* sec_reltext = section_by_name(".rel.text");
-	if (!sec_reltext) return true;
+	dll_free();
+	symbols.index = SHN_UNDEF;
 
-	relocation_section_accessor reltext(elf, sec_reltext);
-	symbol_section_accessor symbols(elf, elf.sections[sec_reltext->get_link()]);
+	if (ret) ret = timed("sections_index", &dino_dll::sections_index);
+	if (ret) ret = timed("sections_merge", &dino_dll::sections_merge);
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+	{
+		dino_timer timer(stats, "relocs_decode");
+		if (ret) ret = relocs_decode(reltext, ROLE_RELTEXT);
+		if (ret) ret = relocs_decode(relrodata, ROLE_RELRODATA);
+		if (ret) ret = relocs_decode(reldata, ROLE_RELDATA);
+		if (ret) ret = relocs_decode(relexports, ROLE_RELEXPORTS);
+		if (ret) ret = relocs_pair(reltext);
+	}
 
-	int pos = 0;
+	// GOT16s decide GOT entries, so before anything sizes the GOT
+	if (ret) ret = timed("pieces_rebase", &dino_dll::pieces_rebase);
 
-	for (unsigned int i = 0; i < reltext.get_entries_num(); i++)
-	{
-		reltext.get_entry(i, offset, symbol, type, addend);
-		symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+	// must run before create(), relaxed calls no longer take a GOT slot
+	if (ret) ret = timed("calls_relax", &dino_dll::calls_relax);
 
-		if (name == "_gp_disp" && type == R_MIPS_HI16)
-		{
-			u8* buffer = gptable + (pos * sizeof(u32));
-			putbe32(buffer, (u32) offset);
-			pos++;
-		}
+	if (ret) ret = timed("create", &dino_dll::create);
+
+	if (ret) ret = timed("header_build", &dino_dll::header_build);
+	if (ret) ret = timed("sections_copy", &dino_dll::sections_copy);
+	if (ret) ret = timed("pieces_patch", &dino_dll::pieces_patch);
+
+	if (ret) ret = timed("exports_build", &dino_dll::exports_build);
+	if (ret) ret = timed("gpstub_patch", &dino_dll::gpstub_patch);
+	if (ret) ret = timed("calls_patch", &dino_dll::calls_patch);
+	if (ret) ret = timed("loads_patch", &dino_dll::loads_patch);
+	if (ret) ret = timed("gprel_patch", &dino_dll::gprel_patch);
+	if (ret) ret = timed("relocs_apply", &dino_dll::relocs_apply);
+	if (ret) ret = timed("table_build", &dino_dll::table_build);
+
+#ifdef DINO_BSSHACK
+	if (ret) ret = timed("exports_patch", &dino_dll::exports_patch);
+#endif
+
+	// a failed conversion never leaves a partial DLL behind
+	if (!ret)
+	{
+		dll_free();
+		return 1;
 	}
 
-	return true;
+	stats.count("dll size", dll_size);
+	stats.count("bss size", bss_size);
+
+	return 0;
 }
 
-int dino_dll::exports_count(void)
+bool dino_dll::timed(const char* name, bool (dino_dll::*step)(void))
 {
-	section* sec_relexports = section_by_name(".rel.exports");
-	if (!sec_relexports) return 0;
-
-	relocation_section_accessor relexports(elf, sec_relexports);
-	int count = (int) relexports.get_entries_num() - 2; // sans constructor/destructor
-	return max(count, 0);
+	dino_timer timer(stats, name);
+	return (this->*step)();
 }
 
-size_t dino_dll::exports_size(void)
+void dino_dll::layout(void)
 {
-	int count = exports_count();
-	count += 2; // constructor/destructor
-	count += 2; // unused fields
+	size_t table = 0;
 
-	return count * sizeof(u32);
-}
+	// the table sits between .text and .rodata and holds offsets past it,
+	// so size it against a layout without it, then again with it until the
+	// count stops growing; a table bigger than needed only leaves padding
+	for (;;)
+	{
+		gotable_number = 0;
+		gptable_number = -1;
 
-bool dino_dll::exports_build(void)
-{
-	section* sec_relexports = section_by_name(".rel.exports");
-	if (!sec_relexports) return false;
+		dll_size = sizeof(dino_dll_header);
 
-	relocation_section_accessor relexports(elf, sec_relexports);
-	symbol_section_accessor symbols(elf, elf.sections[sec_relexports->get_link()]);
+		exports_offset = dll_size;
+		dll_size += exports_size();
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+		header_size = dll_size;
 
-	int pos = 0;
-	u8* buffer = NULL;
+		text_offset = dll_size;
+		dll_size += align(role_size(ROLE_TEXT), 16);
 
-	for (int j = 0; j < 2; j++)
-	{
-		int start = 0, count = 0;
+		table_offset = dll_size;
+		dll_size += table;
 
-		switch (j)
-		{
-			case 0:
-				start = 0;
-				count = 2;
-				break;
+		rodata_offset = dll_size;
+		dll_size += align(role_size(ROLE_RODATA), 16);
 
-			case 1:
-				start = 2;
-				count = (int) relexports.get_entries_num() - start;
-				break;
-		}
+		data_offset = dll_size;
+		dll_size += align(role_size(ROLE_DATA), 16);
 
-		for (int i = start; i < start + count; i++)
-		{
-			relexports.get_entry(i, offset, symbol, type, addend);
-			symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+		bss_offset = dll_size;
+		dll_size = align(dll_size, 16);
 
-			buffer = exports + (pos * sizeof(u32));
-			putbe32(buffer, (u32) value);
-			pos++;
-		}
+		sections_layout();
 
-		buffer = exports + (pos * sizeof(u32));
-		putbe32(buffer, 0);
-		pos++;
+		size_t needed = table_size();
+		if (needed <= table) break;
+
+		table = needed;
 	}
 
-	return true;
+	bss_size = 0; // jfc.
+	if (role_size(ROLE_BSS) >= (dll_size - bss_offset))
+		bss_size = role_size(ROLE_BSS) - (dll_size - bss_offset);
 }
 
-bool dino_dll::exports_patch(void)
+bool dino_dll::create(void)
 {
-	if (!exports) return false;
-	u8* size = exports + (2 * sizeof(u32));
+	layout();
 
-	// unofficial - this is to avoid having to output a separate file containing just the .bss size
-	// if this field is zero, a repacker should use the original DLLS.tab size (DLL was not recompiled)
-	// if this field is DINO_NONE, the .bss size is zero and should be set to zero in DLLS.tab
-	// otherwise this field contains the true .bss size to set in DLLS.tab
-	// though harmless, the repacker should clear this back to zero, its usage is temporary and unofficial
-	if (bss_size == 0)
-		putbe32(size, DINO_NONE);
-	else
-		putbe32(size, bss_size);
+	// relaxed loads only shrink the GOT, which pulls everything after the
+	// table closer to $gp, so displacements checked here still fit after
+	if (loads_relax()) layout();
 
-	return true;
-}
+	dll = NULL;
+	if (!output_file.empty())
+		dll = output.open(output_file, dll_size);
 
-int dino_dll::gotable_count(void)
-{
-	if (gotable_number) return gotable_number;
+	// a fresh mapping is already zeroed, fall back to the heap without one
+	if (!dll)
+	{
+		dll = new u8[dll_size];
+		memset(dll, 0, dll_size);
+	}
+
+	header = (dino_dll_header*) dll;
+	exports = dll + exports_offset;
 
-	section* sec_reltext = section_by_name(".rel.text");
-	if (!sec_reltext) return false;
+	text = dll + text_offset;
+	if (!role_exists(ROLE_TEXT)) text = NULL;
 
-	relocation_section_accessor reltext(elf, sec_reltext);
-	symbol_section_accessor symbols(elf, elf.sections[sec_reltext->get_link()]);
+	rodata = dll + rodata_offset;
+	if (!role_exists(ROLE_RODATA)) rodata = NULL;
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+	data = dll + data_offset;
+	if (!role_exists(ROLE_DATA)) data = NULL;
 
-	list<u32> entries;
+	table = dll + table_offset;
+	if (table_size() == 0) table = NULL;
 
-	int count = 0;
-	{
-		count++; // .text
-		count++; // .rodata
-		count++; // .data
-		count++; // .bss
-	}
+	if (table)
+		gp_offset = table_offset - header_size;
+	else if (rodata)
+		gp_offset = rodata_offset - header_size;
+
+	return true;
+}
+
+void dino_dll::dll_free(void)
+{
+	if (output.mapped())
+		output.discard();
+	else
+		delete[] dll;
+
+	dll = NULL;
+}
+
+template <class T>
+static void symbols_read(elfio& elf, section* sec, dino_symbols& symbols)
+{
+	const endianess_convertor& convertor = elf.get_convertor();
+
+	const char* entries = sec->get_data();
+	Elf_Xword entry_size = sec->get_entry_size();
+	Elf_Xword count = entry_size ? sec->get_size() / entry_size : 0;
+	if (!entries) count = 0;
+
+	const char* strings = NULL;
+	Elf_Xword strings_size = 0;
+	if (sec->get_link() < elf.sections.size())
+	{
+		strings = elf.sections[sec->get_link()]->get_data();
+		strings_size = elf.sections[sec->get_link()]->get_size();
+	}
+
+	symbols.value.resize(count);
+	symbols.section.resize(count);
+	symbols.gp_disp.resize(count);
+
+	for (Elf_Xword i = 0; i < count; i++)
+	{
+		const T* sym = (const T*) (entries + i * entry_size);
+		Elf_Word name = convertor(sym->st_name);
+
+		symbols.value[i] = (u32) convertor(sym->st_value);
+		symbols.section[i] = convertor(sym->st_shndx);
+		symbols.gp_disp[i] = 0;
+
+		if (strings && name < strings_size)
+		{
+			if (!strcmp(strings + name, "_gp_disp"))
+				symbols.gp_disp[i] = DINO_GP_DISP;
+			else if (!strcmp(strings + name, "__gnu_local_gp"))
+				symbols.gp_disp[i] = DINO_GP_LOCAL;
+		}
+	}
+}
+
+bool dino_dll::symbols_decode(Elf_Half id)
+{
+	if (symbols.index == id) return true;
+
+	if (id == SHN_UNDEF || id >= elf.sections.size())
+	{
+		diag << "Relocation section links to invalid symbol table " << id << "." << endl;
+		return false;
+	}
+
+	symbols.index = id;
+
+	if (elf.get_class() == ELFCLASS32)
+		symbols_read<Elf32_Sym>(elf, elf.sections[id], symbols);
+	else
+		symbols_read<Elf64_Sym>(elf, elf.sections[id], symbols);
+
+	return true;
+}
+
+string dino_dll::symbol_name(Elf_Word symbol)
+{
+	string name;
+
+	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
+	unsigned char bind = 0, symbolType = 0, other = 0;
+
+	if (symbols.index == SHN_UNDEF) return name;
+
+	symbol_section_accessor accessor(elf, elf.sections[symbols.index]);
+	accessor.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+
+	return name;
+}
+
+bool dino_dll::relocs_decode(dino_relocs& relocs, dino_role role)
+{
+	relocs.present = false;
+	relocs.offset.clear();
+	relocs.type.clear();
+	relocs.symbol.clear();
+	relocs.section.clear();
+	relocs.value.clear();
+	relocs.gp_disp.clear();
+	relocs.partner.clear();
+
+	const vector<Elf_Half>& members = role_members[role];
+	if (members.empty()) return true;
+
+	size_t count = 0;
+	for (size_t m = 0; m < members.size(); m++)
+	{
+		relocation_section_accessor accessor(elf, elf.sections[members[m]]);
+		count += (size_t) accessor.get_entries_num();
+	}
+
+	stats.count(string("relocations ") + dino_role_names[role], count);
+
+	relocs.present = true;
+	relocs.offset.resize(count);
+	relocs.type.resize(count);
+	relocs.symbol.resize(count);
+	relocs.section.resize(count);
+	relocs.value.resize(count);
+	relocs.gp_disp.resize(count);
+
+	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
+	size_t pos = 0;
+
+	for (size_t m = 0; m < members.size(); m++)
+	{
+		section* sec = elf.sections[members[m]];
+
+		if (!symbols_decode((Elf_Half) sec->get_link()))
+			return false;
+
+		// offsets become relative to the merged section
+		u32 base = (u32) section_merge_offset((u16) sec->get_info());
+
+		relocation_section_accessor accessor(elf, sec);
+		size_t entries = (size_t) accessor.get_entries_num();
+		bool explicit_addends = sec->get_type() == SHT_RELA;
+
+		for (size_t i = 0; i < entries; i++, pos++)
+		{
+			accessor.get_entry(i, offset, symbol, type, addend);
+
+			relocs.offset[pos] = (u32) offset + base;
+			relocs.type[pos] = type;
+			relocs.symbol[pos] = symbol;
+
+			if (explicit_addends)
+				addend_patch(role, relocs.offset[pos], type, addend);
+
+			map<Elf_Word, u32>::const_iterator common = commons.end();
+			if (!commons.empty()) common = commons.find(symbol);
+
+			if (common != commons.end())
+			{
+				// every common symbol lives in the one .bss area
+				relocs.section[pos] = SHN_MIPS_SCOMMON;
+				relocs.value[pos] = common->second;
+				relocs.gp_disp[pos] = false;
+			}
+			else if (symbol < symbols.value.size())
+			{
+				relocs.section[pos] = symbols.section[symbol];
+				relocs.value[pos] = section_map(symbols.section[symbol], symbols.value[symbol]);
+				relocs.gp_disp[pos] = symbols.gp_disp[symbol];
+			}
+			else
+			{
+				relocs.section[pos] = SHN_UNDEF;
+				relocs.value[pos] = 0;
+				relocs.gp_disp[pos] = false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// a RELA addend goes where a REL one would have been, so everything after
+// decoding reads addends the one way, and equivalent inputs convert alike
+void dino_dll::addend_patch(dino_role role, u32 offset, Elf_Word type, Elf_Sxword addend)
+{
+	if (role < ROLE_RELTEXT || role > ROLE_RELDATA) return;
+
+	vector<u8>& bytes = role_merged[ROLE_TEXT + (role - ROLE_RELTEXT)];
+	if ((size_t) offset + sizeof(u32) > bytes.size()) return;
+
+	u8* buffer = &bytes[offset];
+	u32 word = getbe32(buffer);
+
+	switch (type)
+	{
+		case R_MIPS_32:
+		case R_MIPS_GPREL32:
+			word = (u32) addend;
+			break;
+
+		case R_MIPS_26:
+			word = (word & ~MIPS_ARGMASK) | ((u32) (addend >> 2) & MIPS_ARGMASK);
+			break;
+
+		// the upper half rounded so the sign-extended lower half makes up the rest
+		case R_MIPS_HI16:
+		case R_MIPS_GOT16:
+			word = (word & ~MIPS_IMMMASK) | ((u32) ((addend + 0x8000) >> 16) & MIPS_IMMMASK);
+			break;
+
+		case R_MIPS_LO16:
+		case R_MIPS_GPREL16:
+		case R_MIPS_LITERAL:
+		case R_MIPS_CALL16:
+		case R_MIPS_GOT_DISP:
+		case R_MIPS_GOT_PAGE:
+		case R_MIPS_GOT_OFST:
+			word = (word & ~MIPS_IMMMASK) | ((u32) addend & MIPS_IMMMASK);
+			break;
+
+		default:
+			return;
+	}
+
+	putbe32(buffer, word);
+}
+
+// what a "lui" loads so that a sign-extended low half reaches value
+static s64 page(s64 value)
+{
+	return (value + 0x8000) & ~(s64) 0xFFFF;
+}
+
+// pairs relocations by offset rather than by position in the table, which
+// compilers and assemblers are free to reorder
+bool dino_dll::relocs_pair(dino_relocs& relocs)
+{
+	relocs.partner.assign(relocs.size(), DINO_NONE);
+
+	vector<u32> order;
+	bool absolute = false;
+
+	for (size_t i = 0; i < relocs.size(); i++)
+	{
+		switch (relocs.type[i])
+		{
+			case R_MIPS_HI16:
+				absolute |= !relocs.gp_disp[i];
+				// fall through
+			case R_MIPS_LO16:
+			case R_MIPS_GOT16:
+				order.push_back((u32) i);
+				break;
+		}
+	}
+
+	if (order.empty()) return true;
+
+	sort(order.begin(), order.end(), [&](u32 a, u32 b)
+	{
+		if (relocs.symbol[a] != relocs.symbol[b]) return relocs.symbol[a] < relocs.symbol[b];
+		if (relocs.offset[a] != relocs.offset[b]) return relocs.offset[a] < relocs.offset[b];
+		return a < b;
+	});
+
+	// a HI16 takes the next LO16 against its symbol, each LO16 the
+	// nearest upper half before it, shared by however many LO16s follow
+	for (size_t k = 0; k < order.size(); )
+	{
+		Elf_Word symbol = relocs.symbol[order[k]];
+		u32 upper = DINO_NONE;
+		size_t pending = k;
+
+		for (; k < order.size() && relocs.symbol[order[k]] == symbol; k++)
+		{
+			u32 i = order[k];
+
+			if (relocs.type[i] != R_MIPS_LO16)
+			{
+				upper = i;
+				continue;
+			}
+
+			for (; pending < k; pending++)
+			{
+				if (relocs.type[order[pending]] == R_MIPS_HI16)
+					relocs.partner[order[pending]] = i;
+			}
+
+			pending = k + 1;
+			relocs.partner[i] = upper;
+		}
+	}
+
+	const u8* code = (const u8*) role_data(ROLE_TEXT);
+	size_t code_size = role_size(ROLE_TEXT);
+	if (!code) return true;
+
+	bool ret = true;
+
+	// the loader rewrites a $gp setup as "lui $gp; ori $gp", the two have to be adjacent
+	for (size_t i = 0; i < relocs.size(); i++)
+	{
+		if (relocs.type[i] != R_MIPS_HI16 || relocs.gp_disp[i] != DINO_GP_LOCAL) continue;
+
+		u32 offset = relocs.offset[i];
+		u32 lo = relocs.partner[i];
+
+		if (lo == DINO_NONE || relocs.offset[lo] != offset + sizeof(u32) || offset + 2 * sizeof(u32) > code_size ||
+			(getbe32(code + offset) & ~MIPS_IMMMASK) != MIPS_LUI_GP_I16 ||
+			(getbe32(code + offset + sizeof(u32)) & ~MIPS_IMMMASK) != MIPS_ADDIU_GP_I16)
+		{
+			diag << "Unsupported $gp setup at .text+0x" << hex << offset << dec << ", expected lui/addiu of __gnu_local_gp." << endl;
+			ret = false;
+		}
+	}
+
+	if (!absolute || !ret) return ret;
+
+	// an absolute address becomes a load from the GOT, which is only sound
+	// where $gp holds the table, after a setup within the same function
+	vector<u32> stubs, functions;
+
+	for (size_t i = 0; i < relocs.size(); i++)
+	{
+		if (relocs.type[i] == R_MIPS_HI16 && relocs.gp_disp[i])
+			stubs.push_back(relocs.offset[i]);
+	}
+
+	vector<u8> live(elf.sections.size(), 0);
+	for (size_t m = 0; m < role_members[ROLE_TEXT].size(); m++)
+		live[role_members[ROLE_TEXT][m]] = 1;
+
+	for (size_t i = 0; i < section_folded.size(); i++)
+		live[i] |= live[section_folded[i]];
+
+	section* symtab = role_section(ROLE_SYMTAB);
+	if (symtab)
+	{
+		symbol_section_accessor accessor(elf, symtab);
+
+		string name;
+		Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half index = 0;
+		unsigned char bind = 0, type = 0, other = 0;
+
+		for (Elf_Xword i = 0; i < accessor.get_symbols_num(); i++)
+		{
+			accessor.get_symbol(i, name, value, size, bind, type, index, other);
+			if (type != STT_FUNC || index >= live.size() || !live[index]) continue;
+
+			functions.push_back((u32) value + (u32) section_merge_offset(index));
+		}
+	}
+
+	sort(stubs.begin(), stubs.end());
+	sort(functions.begin(), functions.end());
+
+	for (size_t i = 0; i < relocs.size(); i++)
+	{
+		if (relocs.type[i] != R_MIPS_HI16 || relocs.gp_disp[i]) continue;
+
+		u32 offset = relocs.offset[i];
+
+		vector<u32>::const_iterator stub = upper_bound(stubs.begin(), stubs.end(), offset);
+		vector<u32>::const_iterator function = upper_bound(functions.begin(), functions.end(), offset);
+		u32 start = function == functions.begin() ? 0 : *(function - 1);
+
+		if (stub == stubs.begin() || *(stub - 1) < start)
+		{
+			diag << "Absolute address of \"" << symbol_name(relocs.symbol[i]) << "\" at .text+0x" << hex << offset << dec << " is taken without $gp set up, build with -fpic." << endl;
+			ret = false;
+		}
+	}
+
+	return ret;
+}
+
+// whether a LO16 completes a "lui rt, %hi(sym)", rather than a GOT16 or $gp setup
+bool dino_dll::relocs_absolute(size_t i)
+{
+	u32 hi = i < reltext.partner.size() ? reltext.partner[i] : DINO_NONE;
+
+	return hi != DINO_NONE && reltext.type[hi] == R_MIPS_HI16 && !reltext.gp_disp[hi];
+}
+
+// S + A against the final layout, following the addend into merged pieces
+s64 dino_dll::reloc_target(const dino_relocs& relocs, size_t i, s64 addend)
+{
+	Elf_Half section = relocs.section[i];
+
+	if (section_mergeable(section))
+		return gotable_value(section, section_map(section, symbols.value[relocs.symbol[i]] + (u32) addend));
+
+	s64 value = gotable_value(section, relocs.value[i]);
+	if (value < 0) return -1;
+
+	return value + addend;
+}
+
+// fields that need no table: jumps, and the low halves going with a HI16 or GOT page
+bool dino_dll::relocs_apply(void)
+{
+	if (!text || !reltext.present) return true;
+
+	const u8* code = (const u8*) role_data(ROLE_TEXT);
+	bool ret = true;
+	size_t jumps = 0, absolutes = 0;
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		u32 offset = reltext.offset[i];
+		Elf_Word type = reltext.type[i];
+		Elf_Word symbol = reltext.symbol[i];
+		Elf_Half section = reltext.section[i];
+
+		u32 insn = getbe32(code + offset);
+		s64 target = 0;
+
+		switch (type)
+		{
+			// absolute jumps can't be relocated at load time, branches can
+			case R_MIPS_26:
+			{
+				target = reloc_target(reltext, i, (s64) (insn & MIPS_ARGMASK) << 2);
+				if (target < 0)
+				{
+					err_unk_sym(".text", offset, symbol_name(symbol), symbol);
+					ret = false;
+					continue;
+				}
+
+				s64 displacement = (target - (s64) (offset + sizeof(u32))) / (s64) sizeof(u32);
+				bool local = section < section_roles.size() && section_roles[section] == ROLE_TEXT;
+
+				u32 branch = 0;
+				if ((insn & MIPS_OPMASK) == MIPS_JAL) branch = MIPS_BAL;
+				else if ((insn & MIPS_OPMASK) == MIPS_J) branch = MIPS_B;
+
+				if (!branch || !local || displacement < -0x8000 || displacement > 0x7FFF)
+				{
+					diag << "Jump to \"" << symbol_name(symbol) << "\" at .text+0x" << hex << offset << dec << " can't be turned into a branch." << endl;
+					ret = false;
+					continue;
+				}
+
+				putbe32(text + offset, branch | ((u32) displacement & MIPS_IMMMASK));
+				jumps++;
+				continue;
+			}
+
+			case R_MIPS_LO16:
+			{
+				if (!relocs_absolute(i)) continue;
+
+				u32 hi = reltext.partner[i];
+				s64 addend = ((s64) (getbe32(code + reltext.offset[hi]) & MIPS_IMMMASK) << 16) + (s16) (insn & MIPS_IMMMASK);
+
+				target = reloc_target(reltext, i, addend);
+				if (target < 0 || page(target) != gotable_entry(hi))
+				{
+					diag << "Low half of \"" << symbol_name(symbol) << "\" at .text+0x" << hex << offset << dec << " doesn't share the page of its HI16." << endl;
+					ret = false;
+					continue;
+				}
+
+				absolutes++;
+				break;
+			}
+
+			case R_MIPS_GOT_OFST:
+			{
+				target = reloc_target(reltext, i, (s16) (insn & MIPS_IMMMASK));
+				if (target < 0)
+				{
+					err_unk_sym(".text", offset, symbol_name(symbol), symbol);
+					ret = false;
+					continue;
+				}
+
+				target -= page(target);
+				break;
+			}
+
+			default:
+				continue;
+		}
+
+		putbe32(text + offset, (insn & ~MIPS_IMMMASK) | ((u32) target & MIPS_IMMMASK));
+	}
+
+	stats.count("jumps relaxed", jumps);
+	stats.count("absolute references", absolutes);
+
+	return ret;
+}
+
+size_t dino_dll::table_size(void)
+{
+	size_t size = DINO_TABMIN;
+	size += gotable_size();
+	size += gptable_size();
+	size += datable_size();
+
+	// don't insert a placeholder table if the rodata section doesn't exist
+	if (size == DINO_TABMIN && role_section(ROLE_RODATA) == NULL)
+		return 0;
+
+	return size;
+}
+
+bool dino_dll::table_build(void)
+{
+	bool ret = false;
+	if (!table) return true;
+
+	gotable = table;
+	u8* gotend = gotable + gotable_size();
+	putbe32(gotend, DINO_GOTEND);
+
+	gptable = gotable + gotable_size() + sizeof(u32);
+	u8* gptend = gptable + gptable_size();
+	putbe32(gptend, DINO_GPTEND);
+
+	datable = gptable + gptable_size() + sizeof(u32);
+	u8* datend = datable + datable_size();
+	putbe32(datend, DINO_DATEND);
+
+	ret |= !gotable_build();
+	ret |= !gptable_build();
+	ret |= !datable_build();
+	ret |= !rotable_build();
+
+	return !ret;
+}
+
+bool dino_dll::header_build(void)
+{
+	putbe32(header->header_size, header_size);
+	putbe32(header->data_offset, data ? data_offset : DINO_NONE);
+	putbe32(header->rodata_offset, table ? table_offset : DINO_NONE);
+	putbe16(header->export_count, exports_count());
+	putbe16(header->padding, 0);
+
+	return true;
+}
+
+bool dino_dll::sections_copy(void)
+{
+	if (text) memcpy(text, role_data(ROLE_TEXT), role_size(ROLE_TEXT));
+	if (rodata) memcpy(rodata, role_data(ROLE_RODATA), role_size(ROLE_RODATA));
+	if (data) memcpy(data, role_data(ROLE_DATA), role_size(ROLE_DATA));
+
+	stats.count("copied .text", text ? role_size(ROLE_TEXT) : 0);
+	stats.count("copied .rodata", rodata ? role_size(ROLE_RODATA) : 0);
+	stats.count("copied .data", data ? role_size(ROLE_DATA) : 0);
+
+	return true;
+}
+
+bool dino_dll::gpstub_patch(void)
+{
+	if (!text) return true;
+	if (!reltext.present) return false;
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		// replace "addiu $gp, $gp, #imm16" with "ori $gp, $gp, #imm16"
+		// nop the "addu $gp, $t9"
+		if (reltext.gp_disp[i] && reltext.type[i] == R_MIPS_HI16)
+		{
+			u8* buffer = text + reltext.offset[i];
+
+			putbe32(buffer + sizeof(u32) * 0, MIPS_LUI_GP_I16);
+			putbe32(buffer + sizeof(u32) * 1, MIPS_ORI_GP_I16);
+
+			// there is no $t9 to add for "__gnu_local_gp"
+			if (reltext.gp_disp[i] == DINO_GP_DISP)
+				putbe32(buffer + sizeof(u32) * 2, MIPS_NOP);
+		}
+	}
+	
+	return true;
+}
+
+static bool insn_branches(u32 insn)
+{
+	u32 op = insn >> 26;
+	u32 rs = (insn >> 21) & 0x1F;
+
+	switch (op)
+	{
+		case 0x00: return (insn & 0x3E) == 0x08; // jr, jalr
+		case 0x01: case 0x02: case 0x03:
+		case 0x04: case 0x05: case 0x06: case 0x07:
+		case 0x14: case 0x15: case 0x16: case 0x17:
+			return true;
+		case 0x10: case 0x11: case 0x12: case 0x13:
+			return rs == 0x08; // bczf, bczt
+		default:
+			return false;
+	}
+}
+
+// any register field naming $t9, also matches immediates that merely look like it
+static bool insn_uses_t9(u32 insn)
+{
+	return ((insn >> 21) & 0x1F) == 25 || ((insn >> 16) & 0x1F) == 25 || ((insn >> 11) & 0x1F) == 25;
+}
+
+// a call is only relaxed when nothing but the jalr sees the loaded $t9: the
+// load and the call are straight-line code, nothing in between or in the
+// delay slot touches $t9, and the callee opens with a _gp_disp stub, which
+// gpstub_patch already makes independent of $t9
+bool dino_dll::calls_relax(void)
+{
+	calls.clear();
+
+	if (!options.relax_calls) return true;
+	if (!reltext.present || !role_exists(ROLE_TEXT)) return true;
+
+	const u8* code = (const u8*) role_data(ROLE_TEXT);
+	size_t code_size = role_size(ROLE_TEXT);
+
+	vector<u32> stubs;
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		if (reltext.gp_disp[i] && reltext.type[i] == R_MIPS_HI16)
+			stubs.push_back(reltext.offset[i]);
+	}
+
+	sort(stubs.begin(), stubs.end());
+
+	size_t load = (size_t) -1;
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		if (reltext.type[i] == R_MIPS_CALL16)
+		{
+			load = i;
+			continue;
+		}
+
+		if (reltext.type[i] != R_MIPS_JALR) continue;
+
+		size_t j = load;
+		load = (size_t) -1;
+
+		if (j == (size_t) -1 || reltext.symbol[j] != reltext.symbol[i]) continue;
+		if (reltext.section[j] >= section_roles.size() || section_roles[reltext.section[j]] != ROLE_TEXT) continue;
+
+		u32 from = reltext.offset[j];
+		u32 call = reltext.offset[i];
+		u32 target = reltext.value[j] + (u32) section_merge_offset(reltext.section[j]);
+
+		if (from >= call || call + 2 * sizeof(u32) > code_size || target >= code_size) continue;
+		if ((getbe32(code + from) & 0xFFFF0000) != MIPS_LW_T9_GP) continue;
+		if (getbe32(code + call) != MIPS_JALR_T9) continue;
+		if (!binary_search(stubs.begin(), stubs.end(), target)) continue;
+
+		bool straight = true;
+		for (u32 k = from + sizeof(u32); k < call && straight; k += sizeof(u32))
+		{
+			u32 insn = getbe32(code + k);
+			straight = !insn_branches(insn) && !insn_uses_t9(insn);
+		}
+
+		if (!straight || insn_uses_t9(getbe32(code + call + sizeof(u32)))) continue;
+
+		s64 displacement = ((s64) target - (s64) (call + sizeof(u32))) / (s64) sizeof(u32);
+		if (displacement < -0x8000 || displacement > 0x7FFF) continue;
+
+		calls.push_back({ from, call, target });
+
+		// drop both so neither sizes nor fills a GOT slot
+		reltext.type[j] = R_MIPS_NONE;
+		reltext.type[i] = R_MIPS_NONE;
+	}
+
+	stats.count("calls relaxed", calls.size());
+
+	return true;
+}
+
+// "lw rt, %got(sym)($gp)" against local data becomes "addiu rt, $gp, disp",
+// the LO16 that follows still adds the low half on top
+bool dino_dll::loads_relax(void)
+{
+	loads.clear();
+
+	if (!options.relax_loads) return false;
+	if (!reltext.present || !role_exists(ROLE_TEXT) || table_size() == 0) return false;
+
+	const u8* code = (const u8*) role_data(ROLE_TEXT);
+	size_t code_size = role_size(ROLE_TEXT);
+	s64 gp = (s64) (table_offset - header_size);
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		if (reltext.type[i] != R_MIPS_GOT16) continue;
+
+		u32 offset = reltext.offset[i];
+		if (offset + sizeof(u32) > code_size) continue;
+
+		u32 insn = getbe32(code + offset);
+		if ((insn & MIPS_OPMASK) != MIPS_LW || (insn & MIPS_RSMASK) != MIPS_RS(MIPS_GP)) continue;
+		if (insn & MIPS_IMMMASK) continue;
+
+		s64 value = gotable_value(reltext.section[i], reltext.value[i]);
+		if (value < 0) continue;
+
+		s64 displacement = value - gp;
+		if (displacement < -0x8000 || displacement > 0x7FFF) continue;
+
+		loads.push_back({ offset, reltext.section[i], reltext.value[i] });
+		reltext.type[i] = R_MIPS_NONE;
+	}
+
+	stats.count("loads relaxed", loads.size());
+
+	return !loads.empty();
+}
+
+bool dino_dll::loads_patch(void)
+{
+	if (!text) return true;
+
+	for (size_t i = 0; i < loads.size(); i++)
+	{
+		s64 displacement = gotable_value(loads[i].section, loads[i].value) - (s64) gp_offset;
+		u8* buffer = text + loads[i].offset;
+
+		u32 insn = getbe32(buffer);
+		insn = MIPS_ADDIU | (insn & MIPS_ARGMASK & ~MIPS_IMMMASK) | ((u32) displacement & MIPS_IMMMASK);
+		putbe32(buffer, insn);
+	}
+
+	return true;
+}
+
+bool dino_dll::calls_patch(void)
+{
+	if (!text) return true;
+
+	for (size_t i = 0; i < calls.size(); i++)
+	{
+		s32 displacement = ((s32) calls[i].target - (s32) (calls[i].call + sizeof(u32))) / (s32) sizeof(u32);
+
+		putbe32(text + calls[i].load, MIPS_NOP);
+		putbe32(text + calls[i].call, MIPS_BAL | ((u32) displacement & 0xFFFF));
+	}
+
+	return true;
+}
+
+int dino_dll::gptable_count(void)
+{
+	if (gptable_number >= 0) return gptable_number;
+
+	int count = 0;
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		if (reltext.gp_disp[i] && reltext.type[i] == R_MIPS_HI16)
+			count++;
+	}
+
+	gptable_number = count;
+	return count;
+}
+
+size_t dino_dll::gptable_size(void)
+{
+	return gptable_count() * sizeof(u32);
+}
+
+bool dino_dll::gptable_build(void)
+{
+	if (!reltext.present) return true;
+
+	int pos = 0;
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		if (reltext.gp_disp[i] && reltext.type[i] == R_MIPS_HI16)
+		{
+			u8* buffer = gptable + (pos * sizeof(u32));
+			putbe32(buffer, reltext.offset[i]);
+			pos++;
+		}
+	}
+
+	return true;
+}
+
+int dino_dll::exports_count(void)
+{
+	if (!relexports.present) return 0;
+
+	int count = (int) relexports.size() - 2; // sans constructor/destructor
+	return max(count, 0);
+}
+
+size_t dino_dll::exports_size(void)
+{
+	int count = exports_count();
+	count += 2; // constructor/destructor
+	count += 2; // unused fields
+
+	return count * sizeof(u32);
+}
+
+bool dino_dll::exports_build(void)
+{
+	if (!relexports.present) return false;
+
+	int pos = 0;
+	u8* buffer = NULL;
+
+	for (int j = 0; j < 2; j++)
+	{
+		int start = 0, count = 0;
+
+		switch (j)
+		{
+			case 0:
+				start = 0;
+				count = 2;
+				break;
+
+			case 1:
+				start = 2;
+				count = (int) relexports.size() - start;
+				break;
+		}
+
+		for (int i = start; i < start + count; i++)
+		{
+			buffer = exports + (pos * sizeof(u32));
+			u32 value = 0;
+			if ((size_t) i < relexports.size())
+				value = relexports.value[i] + (u32) section_merge_offset(relexports.section[i]);
+
+			putbe32(buffer, value);
+			pos++;
+		}
+
+		buffer = exports + (pos * sizeof(u32));
+		putbe32(buffer, 0);
+		pos++;
+	}
+
+	return true;
+}
+
+bool dino_dll::exports_patch(void)
+{
+	if (!exports) return false;
+	u8* size = exports + (2 * sizeof(u32));
+
+	// unofficial - this is to avoid having to output a separate file containing just the .bss size
+	// if this field is zero, a repacker should use the original DLLS.tab size (DLL was not recompiled)
+	// if this field is DINO_NONE, the .bss size is zero and should be set to zero in DLLS.tab
+	// otherwise this field contains the true .bss size to set in DLLS.tab
+	// though harmless, the repacker should clear this back to zero, its usage is temporary and unofficial
+	if (bss_size == 0)
+		putbe32(size, DINO_NONE);
+	else
+		putbe32(size, bss_size);
+
+	return true;
+}
+
+int dino_dll::gotable_count(void)
+{
+	if (gotable_number) return gotable_number;
+	if (!reltext.present) return 0;
+
+	int count = 0;
+	{
+		count++; // .text
+		count++; // .rodata
+		count++; // .data
+		count++; // .bss
+	}
+
+	got.reset(reltext.size());
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		switch (reltext.type[i])
+		{
+			case R_MIPS_GOT16:
+			case R_MIPS_CALL16:
+			case R_MIPS_GOT_DISP:
+			case R_MIPS_GOT_PAGE:
+			case R_MIPS_HI16:
+			{
+				s64 value = gotable_entry(i);
+				if (value < 0) continue;
+				got.insert((u32) value);
+				continue;
+			}
+
+			default:
+				continue;
+		}
+	}
+
+	// a reference to a section start takes that section's base slot instead
+	// of a slot of its own; any number of bases may be referenced, and
+	// sections that start at the same offset share one address
+	for (int j = 0; j < 4; j++)
+	{
+		u32 base = (u32) role_offset((dino_role) (ROLE_TEXT + j));
+
+		bool seen = false;
+		for (int k = 0; k < j; k++)
+			seen |= base == (u32) role_offset((dino_role) (ROLE_TEXT + k));
+
+		if (!seen && got.find(base) >= 0)
+			count--;
+	}
+
+	count += (int) got.size();
+
+	gotable_number = count;
+	return count;
+}
+
+size_t dino_dll::gotable_size(void)
+{
+	return gotable_count() * sizeof(u32);
+}
+
+void dino_dll::err_unk_rel(int i, Elf_Word type, const char* section, Elf64_Addr offset, string name, Elf_Word symbol)
+{
+	diag << "Unsupported relocation " << i << " of type " << type << " for " << section << " @ 0x" << hex << offset << dec << " for symbol \"" << name << "\" (" << symbol << ")." << endl;
+}
+
+void dino_dll::err_unk_sym(const char* section, Elf64_Addr offset, string name, Elf_Word symbol)
+{
+	diag << "Undefined symbol \"" << name << "\" (" << symbol << ") in " << section << " @ 0x" << hex << offset << dec << "." << endl;
+}
+
+static const char* reloc_name(Elf_Word type)
+{
+	switch (type)
+	{
+		case R_MIPS_NONE: return "R_MIPS_NONE";
+		case R_MIPS_32: return "R_MIPS_32";
+		case R_MIPS_26: return "R_MIPS_26";
+		case R_MIPS_HI16: return "R_MIPS_HI16";
+		case R_MIPS_LO16: return "R_MIPS_LO16";
+		case R_MIPS_GPREL16: return "R_MIPS_GPREL16";
+		case R_MIPS_LITERAL: return "R_MIPS_LITERAL";
+		case R_MIPS_GOT16: return "R_MIPS_GOT16";
+		case R_MIPS_CALL16: return "R_MIPS_CALL16";
+		case R_MIPS_GPREL32: return "R_MIPS_GPREL32";
+		case R_MIPS_GOT_DISP: return "R_MIPS_GOT_DISP";
+		case R_MIPS_GOT_PAGE: return "R_MIPS_GOT_PAGE";
+		case R_MIPS_GOT_OFST: return "R_MIPS_GOT_OFST";
+		case R_MIPS_JALR: return "R_MIPS_JALR";
+		default: return "unknown";
+	}
+}
+
+string dino_dll::text_relocation(u32 offset)
+{
+	ostringstream out;
+
+	// relaxing rewrote the load and the call of a pair together
+	for (size_t i = 0; i < calls.size(); i++)
+	{
+		if (offset != calls[i].load && offset != calls[i].call) continue;
+
+		out << "call relaxed to a branch to .text+0x" << hex << calls[i].target << dec;
+		return out.str();
+	}
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		u32 start = reltext.offset[i];
+
+		// a $gp setup spans its lui, addiu and, for "_gp_disp", addu
+		size_t words = 1;
+		if (reltext.type[i] == R_MIPS_HI16 && reltext.gp_disp[i])
+			words = reltext.gp_disp[i] == DINO_GP_DISP ? 3 : 2;
+
+		if (offset < start || offset >= start + words * sizeof(u32)) continue;
+
+		// section symbols go by the name of their section
+		string name = symbol_name(reltext.symbol[i]);
+		if (name.empty() && reltext.section[i] < elf.sections.size())
+			name = elf.sections[reltext.section[i]]->get_name();
+
+		// entries count from the start of the relocation section they came from
+		string members;
+		size_t entry = i;
+
+		for (size_t m = 0; m < role_members[ROLE_RELTEXT].size(); m++)
+		{
+			section* sec = elf.sections[role_members[ROLE_RELTEXT][m]];
+			relocation_section_accessor accessor(elf, sec);
+
+			members = sec->get_name();
+			if (entry < accessor.get_entries_num()) break;
+			entry -= (size_t) accessor.get_entries_num();
+		}
+
+		// loads_relax clears the type of the GOT16s it rewrote
+		bool relaxed = false;
+		for (size_t j = 0; j < loads.size() && !relaxed; j++)
+			relaxed = reltext.type[i] == R_MIPS_NONE && loads[j].offset == start;
+
+		if (relaxed)
+			out << "relaxed load of \"" << name << "\"";
+		else
+			out << reloc_name(reltext.type[i]) << " against \"" << name << "\"";
+
+		out << ", entry " << entry << " of " << members;
+		return out.str();
+	}
+
+	return "no relocation";
+}
+
+int dino_dll::gotable_section(Elf_Half id)
+{
+	if (id >= elf.sections.size()) return -1;
+
+	int role = section_roles[id];
+	int index = 0;
+
+	for (int j = ROLE_TEXT; j <= ROLE_BSS; j++)
+	{
+		if (role_exists((dino_role) j))
+		{
+			if (role == j) return index;
+			index++;
+		}
+	}
+
+	return -1;
+}
+
+s64 dino_dll::gotable_value(Elf_Half id, Elf64_Addr value)
+{
+	switch (id)
+	{
+		case SHN_UNDEF:
+		case SHN_COMMON:
+			return -1;
+
+		case SHN_ABS: break;
+
+		default:
+		{
+			return (u32) value + section_offset(id);
+			break;
+		}
+	}
+
+	return (u32) value;
+}
+
+// the value relocation i puts in its GOT slot, negative if it takes none
+s64 dino_dll::gotable_entry(size_t i)
+{
+	const u8* code = (const u8*) role_data(ROLE_TEXT);
+	if (!code || reltext.offset[i] + sizeof(u32) > role_size(ROLE_TEXT)) return -1;
+
+	u32 insn = getbe32(code + reltext.offset[i]);
+	s64 addend = (s16) (insn & MIPS_IMMMASK);
+
+	switch (reltext.type[i])
+	{
+		// a local GOT16 carries the upper half of its addend, LO16 the rest
+		case R_MIPS_GOT16:
+		case R_MIPS_CALL16:
+		{
+			s64 value = gotable_value(reltext.section[i], reltext.value[i]);
+			if (value < 0) return -1;
+			return value + ((s64) (insn & MIPS_IMMMASK) << 16);
+		}
+
+		case R_MIPS_GOT_DISP:
+			return reloc_target(reltext, i, addend);
+
+		case R_MIPS_GOT_PAGE:
+		{
+			s64 value = reloc_target(reltext, i, addend);
+			if (value < 0) return -1;
+			return page(value);
+		}
+
+		case R_MIPS_HI16:
+		{
+			if (reltext.gp_disp[i]) return -1;
+
+			addend = (s64) (insn & MIPS_IMMMASK) << 16;
+
+			u32 lo = i < reltext.partner.size() ? reltext.partner[i] : DINO_NONE;
+			if (lo != DINO_NONE)
+				addend += (s16) (getbe32(code + reltext.offset[lo]) & MIPS_IMMMASK);
+
+			s64 value = reloc_target(reltext, i, addend);
+			if (value < 0) return -1;
+			return page(value);
+		}
+
+		default:
+			return -1;
+	}
+}
+
+bool dino_dll::gotable_build(void)
+{
+	memset(gotable, 0xFF, gotable_size());
+
+	if (!reltext.present) return true;
+
+	bool ret = true;
+	u32 insn = 0;
+	size_t references = 0;
+
+	// the section bases always occupy the first four slots
+	int base_index[4];
+
+	got.reset(gotable_count());
+
+	for (int j = 0; j < 4; j++)
+	{
+		base_index[j] = role_index((dino_role) (ROLE_TEXT + j));
+		got.append((u32) role_offset((dino_role) (ROLE_TEXT + j)));
+	}
+
+	for (size_t i = 0; i < reltext.size(); i++)
+	{
+		u32 offset = reltext.offset[i];
+		Elf_Word type = reltext.type[i];
+		Elf_Word symbol = reltext.symbol[i];
+		Elf_Half section = reltext.section[i];
+
+		switch (type)
+		{
+			// applied in place by gprel_patch and relocs_apply
+			case R_MIPS_NONE:
+			case R_MIPS_26:
+			case R_MIPS_LO16:
+			case R_MIPS_GPREL16:
+			case R_MIPS_LITERAL:
+			case R_MIPS_GOT_OFST:
+				continue;
+
+			case R_MIPS_HI16:
+			case R_MIPS_GOT16:
+			case R_MIPS_CALL16:
+			case R_MIPS_GOT_DISP:
+			case R_MIPS_GOT_PAGE:
+			{
+				if (type == R_MIPS_HI16 && reltext.gp_disp[i]) continue;
+
+				s64 value = gotable_entry(i);
+				if (value < 0)
+				{
+					err_unk_sym(".text", offset, symbol_name(symbol), symbol);
+					ret = false;
+					continue;
+				}
+
+				int index = -1;
+				for (int j = 0; j < 4 && index < 0; j++)
+				{
+					if (section == base_index[j] && (u32) value == got.entry(j))
+						index = j;
+				}
+
+				if (index < 0)
+					index = got.insert((u32) value);
+
+				references++;
+
+				insn = getbe32(text + offset);
+
+				// "lui rt, %hi(sym)" loads the page from the GOT instead
+				if (type == R_MIPS_HI16)
+					insn = MIPS_LW | MIPS_RS(MIPS_GP) | (insn & MIPS_RTMASK);
+
+				insn = (insn & ~MIPS_IMMMASK) | (u32) (index * sizeof(u32));
+				putbe32(text + offset, insn);
+
+				continue;
+			}
+
+			// cool story bro
+			case R_MIPS_JALR:
+				continue;
+
+			default:
+			{
+				err_unk_rel(i, type, ".text", offset, symbol_name(symbol), symbol);
+				ret = false;
+				continue;
+			}
+		}
+	}
+
+	for (size_t slot = 0; slot < got.size(); slot++)
+		putbe32(gotable + (slot * sizeof(u32)), got.entry((int) slot));
+
+	stats.count("got slots", got.size());
+	stats.count("got references", references);
+	stats.count("got deduplicated", references - (got.size() - 4));
+
+	return ret;
+}
+
+bool dino_dll::rotable_build(void)
+{
+	if (!relrodata.present) return true;
+
+	bool ret = true;
+
+	for (size_t i = 0; i < relrodata.size(); i++)
+	{
+		u32 offset = relrodata.offset[i];
+		Elf_Word type = relrodata.type[i];
+		Elf64_Addr value = 0;
+
+		switch (type)
+		{
+			case R_MIPS_GPREL32:
+			{
+				value = getbe32(rodata + offset);
+
+				if (value < gp_offset)
+					value = -((s32) gp_offset - (s32) (value + section_offset(relrodata.section[i])));
+				else
+					value = (value + section_offset(relrodata.section[i])) - gp_offset;
+
+				putbe32(rodata + offset, (u32) value);
+				break;
+			}
+
+			default:
+			{
+				err_unk_rel(i, type, ".rodata", offset, symbol_name(relrodata.symbol[i]), relrodata.symbol[i]);
+				ret = false;
+				continue;
+			}
+		}
+	}
+
+	return ret;
+}
+
+int dino_dll::datable_count(void)
+{
+	return (int) reldata.size();
+}
+
+size_t dino_dll::datable_size(void)
+{
+	return datable_count() * sizeof(u32);
+}
+
+bool dino_dll::datable_build(void)
+{
+	if (!reldata.present) return true;
+
+	bool ret = true;
+
+	u8* buffer = NULL;
+	int pos = 0;
+
+	for (size_t i = 0; i < reldata.size(); i++)
+	{
+		u32 offset = reldata.offset[i];
+		Elf_Word type = reldata.type[i];
+		Elf64_Addr value = reldata.value[i];
+
+		switch (type)
+		{
+			case R_MIPS_32:
+			{
+				value += section_offset(reldata.section[i]);
+				value -= role_offset(ROLE_DATA); // %$?!
+				value += getbe32(data + offset);
+				putbe32(data + offset, (u32) value);
+				break;
+			}
+
+			default:
+			{
+				err_unk_rel(i, type, ".data", offset, symbol_name(reldata.symbol[i]), reldata.symbol[i]);
+				ret = false;
+				continue;
+			}
+		}
+
+		buffer = datable + (pos * sizeof(u32));
+		putbe32(buffer, offset);
+
+		pos++;
+	}
+
+	return ret;
+}
+
+void dino_dll::elf_dump(void)
+{
+	dump::header(cout, elf);
+	dump::section_headers(cout, elf);
+	dump::segment_headers(cout, elf);
+	dump::symbol_tables(cout, elf);
+	dump::notes(cout, elf);
+	dump::modinfo(cout, elf);
+	dump::dynamic_tags(cout, elf);
+	dump::section_datas(cout, elf);
+	dump::segment_datas(cout, elf);
+}
+
+bool dino_dll::sections_index(void)
+{
+	Elf_Half count = elf.sections.size();
+
+	for (int j = 0; j < ROLE_COUNT; j++)
+	{
+		role_sections[j] = NULL;
+		role_members[j].clear();
+		role_merged[j].clear();
+	}
+
+	section_roles.assign(count, ROLE_NONE);
+	section_bases.assign(count, 0);
+	section_merged.assign(count, 0);
+	section_small.assign(count, 0);
+
+	for (Elf_Half i = 0; i < count; i++)
+	{
+		section* sec = elf.sections[i];
+		string name = name_rel(sec->get_name());
+
+		for (int j = 0; j < ROLE_COUNT; j++)
+		{
+			if (!role_matches(name, (dino_role) j)) continue;
+
+			section_roles[i] = j;
+			section_small[i] = role_small(name);
+			role_members[j].push_back(i);
+			break;
+		}
+	}
+
+	return true;
+}
+
+// -ffunction-sections and -fdata-sections output, ".text.foo" and friends,
+// merge into the section they are named after
+bool dino_dll::role_matches(const string& name, dino_role role)
+{
+	bool suffix = role >= ROLE_TEXT && role <= ROLE_RELDATA;
+	if (name_matches(name, dino_role_names[role], suffix)) return true;
+
+	for (size_t i = 0; i < sizeof(dino_small_names) / sizeof(dino_small_names[0]); i++)
+	{
+		if (dino_small_names[i].role == role && name_matches(name, dino_small_names[i].name, true))
+			return true;
+	}
+
+	return false;
+}
+
+bool dino_dll::role_small(const string& name)
+{
+	for (size_t i = 0; i < sizeof(dino_small_names) / sizeof(dino_small_names[0]); i++)
+	{
+		if (name_matches(name, dino_small_names[i].name, true))
+			return true;
+	}
+
+	return false;
+}
+
+// relocation sections by the section they apply to
+void dino_dll::sections_applied(vector<vector<Elf_Half> >& applied)
+{
+	Elf_Half count = elf.sections.size();
+	applied.assign(count, vector<Elf_Half>());
+
+	for (int j = ROLE_RELTEXT; j <= ROLE_RELDATA; j++)
+	{
+		for (size_t m = 0; m < role_members[j].size(); m++)
+		{
+			Elf_Half id = role_members[j][m];
+			Elf_Word info = elf.sections[id]->get_info();
+
+			if (info < count)
+				applied[info].push_back(id);
+		}
+	}
+}
+
+// the relocations of one input section, with targets other than the section
+// itself or an undefined symbol named by their (folded) section and value
+void dino_dll::section_signature(Elf_Half id, const vector<Elf_Half>& rels, vector<u64>& signature)
+{
+	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
+
+	signature.clear();
+
+	for (size_t r = 0; r < rels.size(); r++)
+	{
+		section* sec = elf.sections[rels[r]];
+		if (!symbols_decode((Elf_Half) sec->get_link())) continue;
+
+		relocation_section_accessor accessor(elf, sec);
+		size_t entries = (size_t) accessor.get_entries_num();
+
+		for (size_t i = 0; i < entries; i++)
+		{
+			accessor.get_entry(i, offset, symbol, type, addend);
+
+			u64 target = ((u64) 1 << 32) | symbol;
+			u64 value = 0;
+
+			if (symbol < symbols.section.size() && symbols.section[symbol] != SHN_UNDEF)
+			{
+				Elf_Half index = symbols.section[symbol];
+				if (index < section_folded.size()) index = section_folded[index];
+
+				target = index == id ? ((u64) 2 << 32) : index;
+				value = symbols.value[symbol];
+			}
+
+			signature.push_back(((u64) offset << 32) | type);
+			signature.push_back(target);
+			signature.push_back(value);
+			signature.push_back((u64) addend);
+		}
+	}
+}
+
+// identical code folding: .text input sections with the same bytes and the
+// same relocations collapse onto the first copy, which takes over their
+// place in the merge, so every reference follows without rewriting. a
+// function whose address is stored in .data or .rodata may be compared
+// against another and is left alone
+void dino_dll::sections_fold(vector<u8>& keep)
+{
+	Elf_Half count = elf.sections.size();
+
+	section_folded.resize(count);
+	for (Elf_Half i = 0; i < count; i++)
+		section_folded[i] = i;
+
+	if (!options.fold_code) return;
+
+	vector<vector<Elf_Half> > applied;
+	sections_applied(applied);
+
+	vector<u8> taken(count, 0);
+	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
+
+	for (int j = ROLE_RELRODATA; j <= ROLE_RELDATA; j++)
+	{
+		for (size_t m = 0; m < role_members[j].size(); m++)
+		{
+			section* sec = elf.sections[role_members[j][m]];
+			if (!symbols_decode((Elf_Half) sec->get_link())) continue;
+
+			relocation_section_accessor accessor(elf, sec);
+			size_t entries = (size_t) accessor.get_entries_num();
+
+			for (size_t i = 0; i < entries; i++)
+			{
+				accessor.get_entry(i, offset, symbol, type, addend);
+				if (symbol < symbols.section.size() && symbols.section[symbol] < count)
+					taken[symbols.section[symbol]] = 1;
+			}
+		}
+	}
+
+	vector<Elf_Half> candidates;
+	vector<u64> hashes;
+
+	for (size_t m = 0; m < role_members[ROLE_TEXT].size(); m++)
+	{
+		Elf_Half id = role_members[ROLE_TEXT][m];
+		section* sec = elf.sections[id];
+
+		if (!keep[id] || taken[id] || name_plain(sec->get_name(), ROLE_TEXT)) continue;
+		if (sec->get_size() == 0 || !sec->get_data()) continue;
+
+		candidates.push_back(id);
+		hashes.push_back(hash64((const u8*) sec->get_data(), (size_t) sec->get_size(), 0));
+	}
+
+	size_t folded = 0, saved = 0;
+
+	// folding one pair can make the functions calling them identical too
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		map<u64, vector<size_t> > buckets;
+		vector<vector<u64> > signatures(candidates.size());
+
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			Elf_Half id = candidates[c];
+			if (section_folded[id] != id) continue;
+
+			section_signature(id, applied[id], signatures[c]);
+
+			const vector<u64>& signature = signatures[c];
+			u64 hash = hash64(signature.empty() ? NULL : (const u8*) &signature[0], signature.size() * sizeof(u64), hashes[c]);
+
+			vector<size_t>& bucket = buckets[hash];
+			size_t size = (size_t) elf.sections[id]->get_size();
+
+			for (size_t b = 0; b < bucket.size(); b++)
+			{
+				Elf_Half survivor = candidates[bucket[b]];
+				if (elf.sections[survivor]->get_size() != size) continue;
+				if (signatures[bucket[b]] != signature) continue;
+				if (memcmp(elf.sections[survivor]->get_data(), elf.sections[id]->get_data(), size)) continue;
+
+				section_folded[id] = survivor;
+				keep[id] = 0;
+				changed = true;
+
+				folded++;
+				saved += size;
+				break;
+			}
+
+			if (section_folded[id] == id)
+				bucket.push_back(c);
+		}
+	}
+
+	stats.count("icf functions folded", folded);
+	stats.count("icf bytes saved", saved);
+}
+
+// only sections reachable from the exports, following relocations, are
+// kept, the sections named exactly after a role always are
+void dino_dll::sections_gc(vector<u8>& keep)
+{
+	Elf_Half count = elf.sections.size();
+	bool split = false;
+
+	keep.assign(count, 1);
+
+	for (int j = ROLE_TEXT; j <= ROLE_BSS; j++)
+	{
+		for (size_t m = 0; m < role_members[j].size(); m++)
+		{
+			Elf_Half id = role_members[j][m];
+			if (name_plain(elf.sections[id]->get_name(), (dino_role) j)) continue;
+
+			keep[id] = 0;
+			split = true;
+		}
+	}
+
+	if (!split || !options.gc_sections) 
+	{
+		keep.assign(count, 1);
+		return;
+	}
+
+	vector<vector<Elf_Half> > applied;
+	sections_applied(applied);
+
+	vector<Elf_Half> work(role_members[ROLE_RELEXPORTS]);
+
+	// exports are the roots, kept sections may reach dropped ones
+	for (Elf_Half i = 0; i < count; i++)
+	{
+		if (keep[i] && section_roles[i] >= ROLE_TEXT && section_roles[i] <= ROLE_BSS)
+			work.insert(work.end(), applied[i].begin(), applied[i].end());
+	}
+
+	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
+
+	while (!work.empty())
+	{
+		section* sec = elf.sections[work.back()];
+		work.pop_back();
+
+		if (!symbols_decode((Elf_Half) sec->get_link())) continue;
+
+		relocation_section_accessor accessor(elf, sec);
+		size_t entries = (size_t) accessor.get_entries_num();
+
+		for (size_t i = 0; i < entries; i++)
+		{
+			accessor.get_entry(i, offset, symbol, type, addend);
+			if (symbol >= symbols.section.size()) continue;
+
+			Elf_Half target = symbols.section[symbol];
+			if (target >= count || keep[target]) continue;
+
+			keep[target] = 1;
+			work.insert(work.end(), applied[target].begin(), applied[target].end());
+		}
+	}
+}
+
+// hot .text input sections first, by samples, then the cold ones in input
+// order, the merge places them and every .text fixup follows
+bool dino_dll::sections_order(void)
+{
+	if (options.profile_file.empty()) return true;
+
+	dino_profile profile;
+	if (!profile_read(options.profile_file, profile, diag))
+		return false;
+
+	section* symtab = role_section(ROLE_SYMTAB);
+	vector<Elf_Half>& members = role_members[ROLE_TEXT];
+	if (!symtab || members.size() < 2) return true;
+
+	vector<u64> samples(elf.sections.size(), 0);
+	size_t matched = 0;
+
+	symbol_section_accessor accessor(elf, symtab);
+	Elf_Xword count = accessor.get_symbols_num();
+
+	string name;
+	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half index = 0;
+	unsigned char bind = 0, type = 0, other = 0;
+
+	for (Elf_Xword i = 0; i < count; i++)
+	{
+		accessor.get_symbol(i, name, value, size, bind, type, index, other);
+		if (index >= samples.size() || section_roles[index] != ROLE_TEXT) continue;
+		index = section_folded[index];
+
+		dino_profile::const_iterator hot = profile.find(name);
+		if (hot == profile.end()) continue;
+
+		samples[index] += hot->second;
+		matched++;
+	}
+
+	stable_sort(members.begin(), members.end(), [&](Elf_Half a, Elf_Half b) {
+		return samples[a] > samples[b];
+	});
+
+	role_sections[ROLE_TEXT] = elf.sections[members[0]];
+
+	stats.count("profile symbols matched", matched);
+
+	return true;
+}
+
+// SHF_MERGE inputs split into strings or fixed size constants, each distinct
+// piece is kept once. byte strings without extra alignment also share tails,
+// "bar" lands inside "foobar". returns the alignment the area needs
+size_t dino_dll::sections_pieces(const vector<Elf_Half>& inputs, vector<u8>& area)
+{
+	// inputs only share pieces with inputs of the same kind
+	map<u64, vector<Elf_Half> > kinds;
+	size_t area_alignment = 1;
+	size_t pieces = 0, input_bytes = 0;
+
+	for (size_t m = 0; m < inputs.size(); m++)
+	{
+		section* sec = elf.sections[inputs[m]];
+		u64 strings = (sec->get_flags() & SHF_STRINGS) ? 1 : 0;
+		u64 alignment = max(sec->get_addr_align(), (Elf_Xword) 1);
+
+		kinds[(strings << 63) | ((u64) sec->get_entry_size() << 32) | alignment].push_back(inputs[m]);
+	}
+
+	for (map<u64, vector<Elf_Half> >::const_iterator kind = kinds.begin(); kind != kinds.end(); ++kind)
+	{
+		bool strings = (kind->first >> 63) != 0;
+		size_t unit = (size_t) ((kind->first >> 32) & 0x7FFFFFFF);
+		size_t alignment = (size_t) (kind->first & 0xFFFFFFFF);
+		bool tail = strings && unit == 1 && alignment == 1;
+
+		map<string, size_t> index;
+		vector<string> unique;
+
+		for (size_t m = 0; m < kind->second.size(); m++)
+		{
+			Elf_Half id = kind->second[m];
+			const char* bytes = elf.sections[id]->get_data();
+			size_t size = section_size(id);
+			size_t offset = 0;
+
+			input_bytes += size;
+
+			while (offset < size)
+			{
+				size_t length = unit;
+
+				// a string runs up to and including an all-zero unit
+				if (strings)
+				{
+					length = 0;
+					while (offset + length < size)
+					{
+						const char* entry = bytes + offset + length;
+						length += unit;
+
+						if (count(entry, entry + unit, 0) == (ptrdiff_t) unit) break;
+					}
+				}
+
+				string piece(bytes + offset, length);
+				map<string, size_t>::iterator found = index.find(piece);
+				if (found == index.end())
+				{
+					found = index.insert(make_pair(piece, unique.size())).first;
+					unique.push_back(piece);
+				}
+
+				section_pieces[id].push_back(make_pair((u32) offset, (u32) found->second));
+				pieces++;
+
+				offset += length;
+			}
+		}
+
+		vector<u32> placed(unique.size());
+
+		size_t base = align(area.size(), alignment);
+		area.resize(base);
+		area_alignment = max(area_alignment, alignment);
+
+		if (tail)
+		{
+			vector<string> reversed(unique.size());
+			vector<size_t> order(unique.size());
+
+			for (size_t i = 0; i < unique.size(); i++)
+			{
+				reversed[i].assign(unique[i].rbegin(), unique[i].rend());
+				order[i] = i;
+			}
+
+			sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+				return reversed[a] < reversed[b];
+			});
+
+			// a string sorting just before one it is the tail of lives inside it
+			for (size_t k = order.size(); k-- > 0; )
+			{
+				size_t i = order[k];
+
+				if (k + 1 < order.size())
+				{
+					size_t next = order[k + 1];
+					if (reversed[next].compare(0, reversed[i].size(), reversed[i]) == 0)
+					{
+						placed[i] = placed[next] + (u32) (unique[next].size() - unique[i].size());
+						continue;
+					}
+				}
+
+				placed[i] = (u32) area.size();
+				area.insert(area.end(), unique[i].begin(), unique[i].end());
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < unique.size(); i++)
+			{
+				area.resize(align(area.size(), alignment));
+				placed[i] = (u32) area.size();
+				area.insert(area.end(), unique[i].begin(), unique[i].end());
+			}
+		}
+
+		for (size_t m = 0; m < kind->second.size(); m++)
+		{
+			vector<pair<u32, u32> >& offsets = section_pieces[kind->second[m]];
+			for (size_t p = 0; p < offsets.size(); p++)
+				offsets[p].second = placed[offsets[p].second];
+		}
+	}
+
+	stats.count("merge pieces", pieces);
+	stats.count("merge bytes saved", input_bytes > area.size() ? input_bytes - area.size() : 0);
+
+	return area_alignment;
+}
+
+// SHN_COMMON and SHN_MIPS_SCOMMON symbols get a place of their own, their
+// value is the alignment. returns the bytes they take
+size_t dino_dll::commons_allocate(void)
+{
+	commons.clear();
+
+	section* symtab = role_section(ROLE_SYMTAB);
+	if (!symtab || !symbols_decode(symtab->get_index())) return 0;
+
+	symbol_section_accessor accessor(elf, symtab);
+
+	string name;
+	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half index = 0;
+	unsigned char bind = 0, type = 0, other = 0;
+
+	// the small ones first, they are the ones addressed from $gp
+	const Elf_Half kinds[] = { SHN_MIPS_SCOMMON, SHN_COMMON };
+	size_t pos = 0;
+
+	for (int k = 0; k < 2; k++)
+	{
+		for (size_t i = 0; i < symbols.section.size(); i++)
+		{
+			if (symbols.section[i] != kinds[k]) continue;
+
+			accessor.get_symbol((Elf_Xword) i, name, value, size, bind, type, index, other);
+			if (value > 1) pos = align(pos, (size_t) value);
+
+			commons[(Elf_Word) i] = (u32) pos;
+			pos += (size_t) size;
+		}
+	}
+
+	stats.count("common symbols", commons.size());
+
+	return pos;
+}
+
+// "lw rt, %gp_rel(sym)($gp)" and literal pool loads, addend in the immediate
+bool dino_dll::gprel_patch(void)
+{
+	if (!text || !reltext.present) return true;
+
+	bool ret = true;
+	size_t patched = 0;
 
-	for (unsigned int i = 0; i < reltext.get_entries_num(); i++)
+	for (size_t i = 0; i < reltext.size(); i++)
 	{
-		reltext.get_entry(i, offset, symbol, type, addend);
-		symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+		u32 offset = reltext.offset[i];
+		Elf_Word type = reltext.type[i];
+		Elf_Word symbol = reltext.symbol[i];
 
-		switch (type)
+		if (type != R_MIPS_GPREL16 && type != R_MIPS_LITERAL) continue;
+
+		s64 value = gotable_value(reltext.section[i], reltext.value[i]);
+		if (value < 0)
 		{
-			case R_MIPS_GOT16:
-			case R_MIPS_CALL16:
-				if (gotable_value(section, value) < 0) continue;
-				entries.push_back((u32) gotable_value(section, value));
-				continue;
+			err_unk_sym(".text", offset, symbol_name(symbol), symbol);
+			ret = false;
+			continue;
+		}
 
-			default:
-				continue;
+		u8* buffer = text + offset;
+		u32 insn = getbe32(buffer);
+
+		s64 displacement = value + (s16) (insn & MIPS_IMMMASK) - (s64) gp_offset;
+		if (displacement < -0x8000 || displacement > 0x7FFF)
+		{
+			diag << "Small data " << symbol_name(symbol) << " at .text+0x" << hex << offset << dec << " is out of $gp range, lower -G." << endl;
+			ret = false;
+			continue;
 		}
+
+		putbe32(buffer, (insn & ~MIPS_IMMMASK) | ((u32) displacement & MIPS_IMMMASK));
+		patched++;
 	}
 
-	entries.sort();
-	entries.unique();
-	count += entries.size() - 1;
+	stats.count("gprel16 relocations", patched);
 
-	gotable_number = count;
-	return count;
+	return ret;
 }
 
-size_t dino_dll::gotable_size(void)
+bool dino_dll::section_mergeable(u16 id)
 {
-	return gotable_count() * sizeof(u32);
+	return id < section_pieces.size() && !section_pieces[id].empty();
 }
 
-void dino_dll::err_unk_rel(int i, Elf_Word type, const char* section, Elf64_Addr offset, string name, Elf_Word symbol)
+// where an offset into a merged input ended up, relative to the merge area
+u32 dino_dll::section_map(u16 id, u32 offset)
 {
-	cerr << "Unsupported relocation " << i << " of type " << type << " for " << section << " @ 0x" << hex << offset << dec << " for symbol \"" << name << "\" (" << symbol << ")." << endl;
-}
+	if (!section_mergeable(id)) return offset;
 
-void dino_dll::err_unk_sym(const char* section, Elf64_Addr offset, string name, Elf_Word symbol)
-{
-	cerr << "Undefined symbol \"" << name << "\" (" << symbol << ") in " << section << " @ 0x" << hex << offset << dec << "." << endl;
+	const vector<pair<u32, u32> >& offsets = section_pieces[id];
+	vector<pair<u32, u32> >::const_iterator piece = upper_bound(offsets.begin(), offsets.end(), make_pair(offset, (u32) -1));
+	if (piece != offsets.begin()) --piece;
+
+	return piece->second + (offset - piece->first);
 }
 
-int dino_dll::gotable_section(Elf_Half id)
+// a local GOT16 and its LO16s split one addend between them, after merging
+// the upper half is picked again, carry included, for wherever the piece went
+bool dino_dll::pieces_rebase(void)
 {
-	if (id >= elf.sections.size()) return -1;
+	if (!reltext.present || !role_exists(ROLE_TEXT)) return true;
 
-	section* sec = elf.sections[id];
-	int index = 0;
-
-	if (section_exists(".text"))
-	{
-		if (sec->get_name() == ".text") return index;
-		index++;
-	}
-	if (section_exists(".rodata"))
-	{
-		if (sec->get_name() == ".rodata") return index;
-		index++;
-	}
-	if (section_exists(".data"))
-	{
-		if (sec->get_name() == ".data") return index;
-		index++;
-	}
-	if (section_exists(".bss"))
-	{
-		if (sec->get_name() == ".bss") return index;
-		index++;
-	}
+	const u8* code = (const u8*) role_data(ROLE_TEXT);
+	size_t code_size = role_size(ROLE_TEXT);
+	if (!code) return true;
 
-	return -1;
-}
+	vector<vector<u32> > lows(reltext.size());
+	bool any = false;
 
-s64 dino_dll::gotable_value(Elf_Half id, Elf64_Addr value)
-{
-	switch (id)
+	for (size_t i = 0; i < reltext.size(); i++)
 	{
-		case SHN_UNDEF:
-		case SHN_MIPS_SCOMMON:
-			return -1;
-
-		case SHN_ABS: break;
+		if (reltext.type[i] != R_MIPS_LO16 || !section_mergeable(reltext.section[i])) continue;
+		if (reltext.partner[i] == DINO_NONE || reltext.type[reltext.partner[i]] != R_MIPS_GOT16) continue;
 
-		default:
-		{
-			return (u32) value + section_offset(id);
-			break;
-		}
+		lows[reltext.partner[i]].push_back((u32) i);
+		any = true;
 	}
 
-	return (u32) value;
-}
+	if (!any) return true;
 
-int dino_dll::gotable_exists(Elf_Half id, Elf64_Addr value)
-{
-	if (!gotable) return -1;
+	// a lone .text is used in place, the immediates are written into a copy
+	if (role_merged[ROLE_TEXT].empty())
+		role_merged[ROLE_TEXT].assign(code, code + code_size);
 
-	u32 entry = (u32) value;
-	switch (id)
+	u8* buffer = &role_merged[ROLE_TEXT][0];
+	bool ret = true;
+	size_t rebased = 0;
+
+	for (size_t g = 0; g < reltext.size(); g++)
 	{
-		case SHN_UNDEF:
-		case SHN_MIPS_SCOMMON:
-			return -1;
+		if (lows[g].empty()) continue;
 
-		case SHN_ABS: break;
+		u32 upper = getbe32(buffer + reltext.offset[g]);
+		u32 value = symbols.value[reltext.symbol[g]];
 
-		default:
+		vector<s64> targets(lows[g].size());
+		for (size_t k = 0; k < lows[g].size(); k++)
 		{
-			entry = (u32) value + section_offset(id);
-			break;
-		}
-	}
-
-	if (entry == section_offset(".text") && id == section_index(".text"))
-		return 0;
-	if (entry == section_offset(".rodata") && id == section_index(".rodata"))
-		return 1;
-	if (entry == section_offset(".data") && id == section_index(".data"))
-		return 2;
-	if (entry == section_offset(".bss") && id == section_index(".bss"))
-		return 3;
+			u32 lower = getbe32(buffer + reltext.offset[lows[g][k]]);
+			s64 addend = ((s64) (upper & MIPS_IMMMASK) << 16) + (s16) (lower & MIPS_IMMMASK);
 
-	for (int i = 0; i < gotable_count(); i++)
-	{
-		u32 address = getbe32(gotable + (i * sizeof(u32)));
-		if (address == entry) return i;
-	}
+			targets[k] = (s64) section_map(reltext.section[g], value + (u32) addend) - reltext.value[g];
+		}
 
-	return -1;
-}
+		s64 half = page(targets[0]);
+		bool shared = true;
 
-bool dino_dll::gotable_entry(u8* buffer, Elf_Half id, Elf64_Addr value)
-{
-	switch (id)
-	{
-		case SHN_UNDEF:
-		case SHN_MIPS_SCOMMON:
-			return false;
+		for (size_t k = 0; k < lows[g].size(); k++)
+		{
+			if (page(targets[k]) != half)
+			{
+				diag << "Merged constant for .text+0x" << hex << reltext.offset[lows[g][k]] << " is no longer in the page of its GOT16 at .text+0x" << reltext.offset[g] << dec << "." << endl;
+				shared = false;
+			}
+		}
 
-		case SHN_ABS:
+		if (!shared)
 		{
-			putbe32(buffer, (u32) value);
-			break;
+			ret = false;
+			continue;
 		}
 
-		default:
+		putbe32(buffer + reltext.offset[g], (upper & ~MIPS_IMMMASK) | ((u32) (half >> 16) & MIPS_IMMMASK));
+
+		for (size_t k = 0; k < lows[g].size(); k++)
 		{
-			putbe32(buffer, (u32) value + section_offset(id));
-			break;
+			u8* lower = buffer + reltext.offset[lows[g][k]];
+			putbe32(lower, (getbe32(lower) & ~MIPS_IMMMASK) | ((u32) (targets[k] - half) & MIPS_IMMMASK));
 		}
+
+		rebased += half != 0;
 	}
 
-	return true;
+	stats.count("got16 pages rebased", rebased);
+
+	return ret;
 }
 
-bool dino_dll::gotable_build(void)
+// addends stored in the instruction or data word follow their piece
+bool dino_dll::pieces_patch(void)
 {
-	memset(gotable, 0xFF, gotable_size());
+	bool ret = true;
 
-	section* sec_reltext = section_by_name(".rel.text");
-	if (!sec_reltext) return true;
+	for (size_t i = 0; text && i < reltext.size(); i++)
+	{
+		if (reltext.type[i] != R_MIPS_LO16 || !section_mergeable(reltext.section[i])) continue;
 
-	relocation_section_accessor reltext(elf, sec_reltext);
-	symbol_section_accessor symbols(elf, elf.sections[sec_reltext->get_link()]);
+		// a HI16 partner is relocs_apply's, a GOT16 one pieces_rebase's
+		if (reltext.partner[i] != DINO_NONE) continue;
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+		u8* buffer = text + reltext.offset[i];
+		u32 insn = getbe32(buffer);
+		u32 value = symbols.value[reltext.symbol[i]];
 
-	bool ret = true;
+		s64 addend = (s64) section_map(reltext.section[i], value + (u32) (s32) (s16) (insn & MIPS_IMMMASK)) - reltext.value[i];
+		if (addend < -0x8000 || addend > 0x7FFF)
+		{
+			diag << "Merged constant for .text+0x" << hex << reltext.offset[i] << dec << " is out of LO16 range." << endl;
+			ret = false;
+			continue;
+		}
 
-	u8* buffer = NULL;
-	int pos = 0;
-	u32 insn = 0;
+		putbe32(buffer, (insn & ~MIPS_IMMMASK) | ((u32) addend & MIPS_IMMMASK));
+	}
 
+	for (size_t i = 0; data && i < reldata.size(); i++)
 	{
-		buffer = gotable + (pos * sizeof(u32));
-		putbe32(buffer, section_offset(".text"));
-		pos++;
-
-		buffer = gotable + (pos * sizeof(u32));
-		putbe32(buffer, section_offset(".rodata"));
-		pos++;
+		if (reldata.type[i] != R_MIPS_32 || !section_mergeable(reldata.section[i])) continue;
 
-		buffer = gotable + (pos * sizeof(u32));
-		putbe32(buffer, section_offset(".data"));
-		pos++;
+		u8* buffer = data + reldata.offset[i];
+		u32 value = symbols.value[reldata.symbol[i]];
 
-		buffer = gotable + (pos * sizeof(u32));
-		putbe32(buffer, section_offset(".bss"));
-		pos++;
+		putbe32(buffer, section_map(reldata.section[i], value + getbe32(buffer)) - reldata.value[i]);
 	}
 
-	list<u32> entries;
-
-	for (unsigned int i = 0; i < reltext.get_entries_num(); i++)
+	// rotable_build only ever looks at the word
+	for (size_t i = 0; rodata && i < relrodata.size(); i++)
 	{
-		reltext.get_entry(i, offset, symbol, type, addend);
-		symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+		if (relrodata.type[i] != R_MIPS_GPREL32 || !section_mergeable(relrodata.section[i])) continue;
 
-		buffer = gotable + (pos * sizeof(u32));
+		u8* buffer = rodata + relrodata.offset[i];
+		putbe32(buffer, section_map(relrodata.section[i], getbe32(buffer)));
+	}
 
-		switch (type)
-		{
-			case R_MIPS_LO16:
-				continue;
+	return ret;
+}
 
-			case R_MIPS_GOT16:
-			case R_MIPS_CALL16:
-			{
-				int index = pos;
+bool dino_dll::sections_merge(void)
+{
+	vector<u8> keep;
+	sections_gc(keep);
+	sections_fold(keep);
 
-				if (gotable_exists(section, value) >= 0)
-				{
-					index = gotable_exists(section, value);
-					pos--;
-				}
-				else
-				{
-					if (!gotable_entry(buffer, section, value))
-					{
-						err_unk_sym(".text", offset, name, symbol);
-						ret = false;
-						continue;
-					}
-					else
-						entries.push_back(getbe32(buffer));
-				}
+	size_t dropped = 0, dropped_bytes = 0;
 
-				insn = getbe32(text + offset);
-				insn |= index * sizeof(u32);
-				putbe32(text + offset, insn);
+	for (int j = 0; j < ROLE_COUNT; j++)
+	{
+		vector<Elf_Half>& members = role_members[j];
+		size_t kept = 0;
 
-				break;
-			}
+		for (size_t m = 0; m < members.size(); m++)
+		{
+			Elf_Half id = members[m];
 
-			case R_MIPS_HI16:
+			// relocations go with the section they apply to
+			Elf_Half target = id;
+			if (j >= ROLE_RELTEXT && j <= ROLE_RELDATA)
+				target = (Elf_Half) elf.sections[id]->get_info();
+
+			if (target < keep.size() && !keep[target])
 			{
-				if (name == "_gp_disp") continue;
+				if (j <= ROLE_BSS && section_folded[id] == id)
+				{
+					dropped++;
+					dropped_bytes += section_size(id);
+				}
 
-				err_unk_rel(i, type, ".text", offset, name, symbol);
-				ret = false;
 				continue;
 			}
 
-			// cool story bro
-			case R_MIPS_JALR:
-				continue;
-
-			default:
-			{
-				err_unk_rel(i, type, ".text", offset, name, symbol);
-				ret = false;
-				continue;
-			}
+			members[kept++] = id;
 		}
 
-		pos++;
+		members.resize(kept);
+		role_sections[j] = members.empty() ? NULL : elf.sections[members[0]];
 	}
 
-	entries.sort();
-	return ret;
-}
+	if (!sections_order()) return false;
 
-bool dino_dll::rotable_build(void)
-{
-	section* sec_relrodata = section_by_name(".rel.rodata");
-	if (!sec_relrodata) return true;
+	for (int j = ROLE_RODATA; j <= ROLE_BSS; j++)
+	{
+		vector<Elf_Half>& members = role_members[j];
+		stable_partition(members.begin(), members.end(), [&](Elf_Half id) { return section_small[id] != 0; });
 
-	relocation_section_accessor relrodata(elf, sec_relrodata);
-	symbol_section_accessor symbols(elf, elf.sections[sec_relrodata->get_link()]);
+		if (!members.empty())
+			role_sections[j] = elf.sections[members[0]];
+	}
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+	vector<vector<Elf_Half> > applied;
+	sections_applied(applied);
 
-	bool ret = true;
+	section_pieces.assign(elf.sections.size(), vector<pair<u32, u32> >());
 
-	for (unsigned int i = 0; i < relrodata.get_entries_num(); i++)
+	for (int j = ROLE_TEXT; j <= ROLE_BSS; j++)
 	{
-		relrodata.get_entry(i, offset, symbol, type, addend);
-		symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+		const vector<Elf_Half>& members = role_members[j];
+		vector<Elf_Half> mergeable;
+		vector<u8> area;
+		size_t pos = 0;
+		bool explicit_addends = false;
 
-		switch (type)
-		{
-			case R_MIPS_GPREL32:
-			{
-				value = getbe32(rodata + offset);
+		// common symbols open .bss, nearest to $gp
+		if (j == ROLE_BSS)
+			pos = commons_allocate();
 
-				if (value < gp_offset)
-					value = -((s32) gp_offset - (s32) (value + section_offset(section)));
-				else
-					value = (value + section_offset(section)) - gp_offset;
+		for (size_t m = 0; m < members.size(); m++)
+		{
+			section* sec = elf.sections[members[m]];
 
-				putbe32(rodata + offset, (u32) value);
-				break;
-			}
+			for (size_t r = 0; r < applied[members[m]].size(); r++)
+				explicit_addends |= elf.sections[applied[members[m]][r]]->get_type() == SHT_RELA;
 
-			default:
+			if (j == ROLE_RODATA && options.merge_constants && (sec->get_flags() & SHF_MERGE) && !section_small[members[m]] &&
+				sec->get_type() == SHT_PROGBITS && sec->get_entry_size() && sec->get_data() &&
+				sec->get_size() % sec->get_entry_size() == 0 && applied[members[m]].empty())
 			{
-				err_unk_rel(i, type, ".rodata", offset, name, symbol);
-				ret = false;
+				mergeable.push_back(members[m]);
 				continue;
 			}
-		}
-	}
-
-	return ret;
-}
 
-int dino_dll::datable_count(void)
-{
-	section* sec_reldata = section_by_name(".rel.data");
-	if (!sec_reldata) return 0;
+			Elf_Xword alignment = sec->get_addr_align();
+			if (alignment > 1) pos = align(pos, (size_t) alignment);
 
-	return (int)(sec_reldata->get_size() / sec_reldata->get_entry_size());
-}
+			section_merged[members[m]] = pos;
+			pos += section_size(members[m]);
+		}
 
-size_t dino_dll::datable_size(void)
-{
-	return datable_count() * sizeof(u32);
-}
+		// the deduplicated pieces go last, all inputs share the area's place
+		size_t area_offset = pos;
+		if (!mergeable.empty())
+		{
+			size_t alignment = sections_pieces(mergeable, area);
+			area_offset = pos = align(pos, alignment);
 
-bool dino_dll::datable_build(void)
-{
-	section* sec_reldata = section_by_name(".rel.data");
-	if (!sec_reldata) return true;
+			for (size_t m = 0; m < mergeable.size(); m++)
+				section_merged[mergeable[m]] = area_offset;
 
-	relocation_section_accessor reldata(elf, sec_reldata);
-	symbol_section_accessor symbols(elf, elf.sections[sec_reldata->get_link()]);
+			pos += area.size();
+		}
 
-	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
-	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half section = 0;
-	unsigned char bind = 0, symbolType = 0, other = 0; string name;
+		role_sizes[j] = pos;
 
-	bool ret = true;
+		// folded sections share the place of their survivor
+		for (size_t i = 0; i < section_folded.size(); i++)
+		{
+			if (section_folded[i] != i && section_roles[i] == j)
+				section_merged[i] = section_merged[section_folded[i]];
+		}
 
-	u8* buffer = NULL;
-	int pos = 0;
+		// a lone section is used in place, unless addends are to be written into it
+		if ((members.size() < 2 && mergeable.empty() && !explicit_addends) || j == ROLE_BSS) continue;
 
-	for (unsigned int i = 0; i < reldata.get_entries_num(); i++)
-	{
-		reldata.get_entry(i, offset, symbol, type, addend);
-		symbols.get_symbol(symbol, name, value, size, bind, symbolType, section, other);
+		role_merged[j].assign(pos, 0);
 
-		switch (type)
+		for (size_t m = 0; m < members.size(); m++)
 		{
-			case R_MIPS_32:
-			{
-				value += section_offset(section);
-				value -= section_offset(".data"); // %$?!
-				value += getbe32(data + offset);
-				putbe32(data + offset, (u32) value);
-				break;
-			}
+			section* sec = elf.sections[members[m]];
+			if (sec->get_type() == SHT_NOBITS || !sec->get_data()) continue;
+			if (section_mergeable(members[m])) continue;
 
-			default:
-			{
-				err_unk_rel(i, type, ".data", offset, name, symbol);
-				ret = false;
-				continue;
-			}
+			memcpy(&role_merged[j][section_merged[members[m]]], sec->get_data(), section_size(members[m]));
 		}
 
-		buffer = datable + (pos * sizeof(u32));
-		putbe32(buffer, (u32) offset);
-
-		pos++;
+		if (!area.empty())
+			memcpy(&role_merged[j][area_offset], &area[0], area.size());
 	}
 
-	return ret;
-}
+	stats.count("gc sections dropped", dropped);
+	stats.count("gc bytes dropped", dropped_bytes);
 
-void dino_dll::elf_dump(void)
-{
-	dump::header(cout, elf);
-	dump::section_headers(cout, elf);
-	dump::segment_headers(cout, elf);
-	dump::symbol_tables(cout, elf);
-	dump::notes(cout, elf);
-	dump::modinfo(cout, elf);
-	dump::dynamic_tags(cout, elf);
-	dump::section_datas(cout, elf);
-	dump::segment_datas(cout, elf);
+	return true;
 }
 
-section* dino_dll::section_by_name(string name)
+void dino_dll::sections_layout(void)
 {
-	for (int i = 0; i < elf.sections.size(); i++)
+	for (size_t i = 0; i < section_roles.size(); i++)
 	{
-		section* sec = elf.sections[i];
-		if (sec->get_name() == name)
-			return sec;
+		switch (section_roles[i])
+		{
+			case ROLE_TEXT:
+			case ROLE_RODATA:
+			case ROLE_DATA:
+			case ROLE_BSS:
+				section_bases[i] = role_offset((dino_role) section_roles[i]) + section_merged[i];
+				break;
+
+			default:
+				section_bases[i] = 0;
+				break;
+		}
 	}
+}
 
-	return NULL;
+section* dino_dll::role_section(dino_role role)
+{
+	return role_sections[role];
 }
 
-int dino_dll::section_index(string name)
+int dino_dll::role_index(dino_role role)
 {
-	section* sec = section_by_name(name);
+	section* sec = role_section(role);
 	if (!sec) return -1;
 
 	return sec->get_index();
 }
 
-const char* dino_dll::section_data(string name)
+const char* dino_dll::role_data(dino_role role)
 {
-	section* sec = section_by_name(name);
+	if (!role_merged[role].empty())
+		return (const char*) &role_merged[role][0];
+
+	section* sec = role_section(role);
 	if (!sec) return NULL;
 
 	return sec->get_data();
 }
 
-bool dino_dll::section_exists(string name)
+bool dino_dll::role_exists(dino_role role)
 {
-	section* sec = section_by_name(name);
-	if (!sec) return false;
+	// .bss may be made of common symbols alone
+	if (role >= ROLE_TEXT && role <= ROLE_BSS)
+		return role_sizes[role] != 0;
 
-	if (sec->get_size() == 0)
-		return false;
+	return role_section(role) != NULL;
+}
 
-	return true;
+size_t dino_dll::role_offset(dino_role role)
+{
+	switch (role)
+	{
+		case ROLE_TEXT:
+			return text_offset - header_size;
+		case ROLE_RODATA:
+			return rodata_offset - header_size;
+		case ROLE_DATA:
+			return data_offset - header_size;
+		case ROLE_BSS:
+			return bss_offset - header_size;
+
+		default:
+			return 0;
+	}
 }
 
-size_t dino_dll::section_offset(string name)
+size_t dino_dll::role_size(dino_role role)
 {
-	if (name == ".text")
-		return text_offset - header_size;
-	if (name == ".rodata")
-		return rodata_offset - header_size;
-	if (name == ".data")
-		return data_offset - header_size;
-	if (name == ".bss")
-		return bss_offset - header_size;
+	if (role >= ROLE_TEXT && role <= ROLE_BSS)
+		return role_sizes[role];
 
-	return 0;
+	section* sec = role_section(role);
+	if (!sec) return 0;
+
+	return section_size(sec->get_index());
 }
 
 size_t dino_dll::section_offset(u16 id)
 {
-	if (id >= elf.sections.size()) return 0;
+	// common symbols open .bss
+	if (id == SHN_MIPS_SCOMMON) return role_offset(ROLE_BSS);
+	if (id >= section_bases.size()) return 0;
 
-	section* sec = elf.sections[id];
-	if (!sec) return 0;
+	return section_bases[id];
+}
 
-	return section_offset(sec->get_name());
+// where an input section starts within its merged role section
+size_t dino_dll::section_merge_offset(u16 id)
+{
+	if (id >= section_merged.size()) return 0;
+
+	return section_merged[id];
 }
 
 size_t dino_dll::section_size(u16 id)
@@ -854,11 +2734,3 @@ size_t dino_dll::section_size(u16 id)
 
 	return (size_t) sec->get_size();
 }
-
-size_t dino_dll::section_size(string name)
-{
-	section* sec = section_by_name(name);
-	if (!sec) return 0;
-
-	return section_size(sec->get_index());
-}
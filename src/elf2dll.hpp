@@ -2,18 +2,30 @@
 
 #include <elfio/elfio.hpp>
 #include "types.h"
+#include "gotable.hpp"
+#include "stats.hpp"
+#include "fileio.hpp"
+#include "profile.hpp"
 
 #define SHN_MIPS_SCOMMON  (0xFF03)
 
+#define R_MIPS_NONE       (0)
 #define R_MIPS_32         (2)
+#define R_MIPS_26         (4)
 #define R_MIPS_HI16       (5)
 #define R_MIPS_LO16       (6)
+#define R_MIPS_GPREL16    (7)
+#define R_MIPS_LITERAL    (8)
 
 #define R_MIPS_GOT16      (9)
 
 #define R_MIPS_CALL16     (11)
 #define R_MIPS_GPREL32    (12)
 
+#define R_MIPS_GOT_DISP   (19)
+#define R_MIPS_GOT_PAGE   (20)
+#define R_MIPS_GOT_OFST   (21)
+
 #define R_MIPS_JALR       (37)
 
 #define MIPS_NOP          (0x00000000)
@@ -21,10 +33,23 @@
 #define MIPS_ADDIU_GP_I16 (0x279C0000)
 #define MIPS_LUI_GP_I16   (0x3C1C0000)
 #define MIPS_ORI_GP_I16   (0x379C0000)
+#define MIPS_LW_T9_GP     (0x8F990000)
+#define MIPS_JALR_T9      (0x0320F809)
+#define MIPS_BAL          (0x04110000)
+#define MIPS_B            (0x10000000)
+#define MIPS_J            (0x08000000)
+#define MIPS_JAL          (0x0C000000)
+#define MIPS_LUI          (0x3C000000)
 
 #define MIPS_OPMASK       (0xFC000000)
 #define MIPS_ARGMASK      (0x03FFFFFF)
 #define MIPS_DSTMASK      (0x00FFFFFF)
+#define MIPS_RSMASK       (0x03E00000)
+#define MIPS_RTMASK       (0x001F0000)
+#define MIPS_IMMMASK      (0x0000FFFF)
+
+#define MIPS_GP           (28)
+#define MIPS_RS(r)        ((u32) (r) << 21)
 
 #define MIPS_RS_GP        (0x03000000)
 #define MIPS_ADDIU        (0x24000000)
@@ -37,6 +62,13 @@
 #define DINO_TABMIN       (3 * sizeof(u32))
 #define DINO_NONE         (0xFFFFFFFF)
 
+// bump whenever the DLL produced for a given input may change
+#define DINO_VERSION      (4)
+
+// how a HI16 sets up $gp: "_gp_disp" is lui/addiu/addu $t9, "__gnu_local_gp" lui/addiu
+#define DINO_GP_DISP      (1)
+#define DINO_GP_LOCAL     (2)
+
 typedef struct {
 	u8 header_size[4];
 	u8 data_offset[4];
@@ -48,10 +80,116 @@ typedef struct {
 using namespace std;
 using namespace ELFIO;
 
+// an ELF object held in memory by the caller
+struct dino_span {
+	const u8* data;
+	size_t size;
+};
+
+// conversion settings, key() covers everything that affects the output
+struct dino_options {
+	string cache_dir;
+	dino_stats_format stats = STATS_NONE;
+	bool relax_calls = false;
+	bool relax_loads = false;
+	bool gc_sections = true;
+	bool fold_code = false;
+	bool merge_constants = true;
+	string profile_file;
+
+	string key(void) const;
+};
+
+// sections the converter knows by name, resolved once after loading
+enum dino_role {
+	ROLE_NONE = -1,
+
+	ROLE_TEXT,
+	ROLE_RODATA,
+	ROLE_DATA,
+	ROLE_BSS,
+
+	ROLE_RELTEXT,
+	ROLE_RELRODATA,
+	ROLE_RELDATA,
+	ROLE_RELEXPORTS,
+
+	ROLE_SYMTAB,
+
+	ROLE_COUNT
+};
+
+// a relocation section decoded once up front, stored as parallel arrays
+struct dino_relocs {
+	bool present;
+
+	vector<u32> offset;
+	vector<Elf_Word> type;
+	vector<Elf_Word> symbol;
+	vector<Elf_Half> section;
+	vector<u32> value;
+	vector<u8> gp_disp;
+
+	// a HI16's first LO16, a LO16's HI16 or GOT16, DINO_NONE when unpaired
+	vector<u32> partner;
+
+	size_t size(void) const { return offset.size(); }
+};
+
+// a "lw $t9, %call16(f)($gp); ...; jalr $t9" pair rewritten to "bal f"
+struct dino_call {
+	u32 load;
+	u32 call;
+	u32 target;
+};
+
+// a local "lw rt, %got(sym)($gp)" rewritten to "addiu rt, $gp, disp"
+struct dino_load {
+	u32 offset;
+	Elf_Half section;
+	u32 value;
+};
+
+// symbol table columns the builders need, without names
+struct dino_symbols {
+	Elf_Half index;
+
+	vector<u32> value;
+	vector<Elf_Half> section;
+	vector<u8> gp_disp;
+};
+
 class dino_dll {
 public:
+	dino_dll(ostream& diag = cerr) : diag(diag), dll(NULL) {}
+	dino_dll(const dino_options& options, ostream& diag = cerr) : options(options), diag(diag), dll(NULL) {}
+	~dino_dll() { dll_free(); }
+
 	int build(string elf_file, string dll_file);
+	int convert(string elf_file);
+
+	// several objects are linked in memory first, the first one provides the exports
+	int build(const vector<string>& elf_files, string dll_file);
+	int convert(const vector<string>& elf_files);
+
+	// converts into memory for the bundle writer, which also needs the true .bss size
+	int build(const vector<string>& elf_files, vector<u8>& image, u32& bss);
+
+	// from memory into memory, the filesystem is only read for options.profile_file
+	int build(const vector<dino_span>& elf_images, vector<u8>& image, u32& bss);
+	int convert(const vector<dino_span>& elf_images);
+
+	const dino_stats& get_stats(void) const { return stats; }
+
+	// what in .rel.text produced the word at a .text offset, for the verifier
+	string text_relocation(u32 offset);
+
+	// times the builders in isolation, see bench/bench.cpp
+	friend class dino_bench;
 private:
+	dino_options options;
+	ostream& diag;
+	dino_stats stats;
 	elfio elf;
 
 	size_t dll_size;
@@ -66,6 +204,10 @@ private:
 	size_t table_offset;
 	size_t gp_offset;
 
+	// build() lays the DLL out straight into its destination file
+	string output_file;
+	file_output output;
+
 	u8* dll;
 	u8* text;
 	u8* rodata;
@@ -77,38 +219,99 @@ private:
 	u8* gptable;
 	u8* datable;
 
+	dino_gotable got;
 	int gotable_number;
+	int gptable_number;
+
+	// input sections making up each role, in merge order, and where each
+	// one lands within the merged section
+	section* role_sections[ROLE_COUNT];
+	vector<Elf_Half> role_members[ROLE_COUNT];
+	vector<u8> role_merged[ROLE_COUNT];
+	size_t role_sizes[ROLE_COUNT];
+	vector<int> section_roles;
+	vector<size_t> section_bases;
+	vector<size_t> section_merged;
+	vector<Elf_Half> section_folded;
+	vector<u8> section_small;
+	map<Elf_Word, u32> commons;
+	vector<vector<pair<u32, u32> > > section_pieces;
+
+	dino_symbols symbols;
+
+	dino_relocs reltext;
+	dino_relocs relrodata;
+	dino_relocs reldata;
+	dino_relocs relexports;
+
+	vector<dino_call> calls;
+	vector<dino_load> loads;
 
 	dino_dll_header* header;
 
+	bool timed(const char* name, bool (dino_dll::*step)(void));
+	int convert_elf(void);
+
+	void layout(void);
 	bool create(void);
+	void dll_free(void);
 	void elf_dump(void);
 
+	bool symbols_decode(Elf_Half id);
+	string symbol_name(Elf_Word symbol);
+	bool relocs_decode(dino_relocs& relocs, dino_role role);
+	void addend_patch(dino_role role, u32 offset, Elf_Word type, Elf_Sxword addend);
+	bool relocs_pair(dino_relocs& relocs);
+	bool relocs_absolute(size_t i);
+	bool relocs_apply(void);
+	s64 reloc_target(const dino_relocs& relocs, size_t i, s64 addend);
+
 	bool header_build(void);
 	bool sections_copy(void);
 
-	section* section_by_name(string name);
-	const char* section_data(string name);
-	int section_index(string name);
-	bool section_exists(string name);
+	bool sections_index(void);
+	bool sections_merge(void);
+	void sections_gc(vector<u8>& keep);
+	void sections_fold(vector<u8>& keep);
+	void sections_applied(vector<vector<Elf_Half> >& applied);
+	void section_signature(Elf_Half id, const vector<Elf_Half>& rels, vector<u64>& signature);
+	bool sections_order(void);
+	size_t sections_pieces(const vector<Elf_Half>& inputs, vector<u8>& area);
+	bool section_mergeable(u16 id);
+	u32 section_map(u16 id, u32 offset);
+	bool pieces_rebase(void);
+	bool pieces_patch(void);
+	size_t commons_allocate(void);
+	bool gprel_patch(void);
+	void sections_layout(void);
+
+	section* role_section(dino_role role);
+	bool role_matches(const string& name, dino_role role);
+	bool role_small(const string& name);
+	const char* role_data(dino_role role);
+	int role_index(dino_role role);
+	bool role_exists(dino_role role);
+	size_t role_offset(dino_role role);
+	size_t role_size(dino_role role);
 
-	size_t section_offset(string name);
 	size_t section_offset(u16 id);
-
-	size_t section_size(string name);
+	size_t section_merge_offset(u16 id);
 	size_t section_size(u16 id);
 
 	bool table_build(void);
 	size_t table_size(void);
 
 	bool gpstub_patch(void);
+	bool calls_relax(void);
+	bool calls_patch(void);
+	bool loads_relax(void);
+	bool loads_patch(void);
 	bool exports_patch(void);
 
 	bool rotable_build(void);
-	bool gotable_entry(u8* buffer, Elf_Half id, Elf64_Addr value);
 	int gotable_section(Elf_Half id);
 	s64 gotable_value(Elf_Half id, Elf64_Addr value);
-	int gotable_exists(Elf_Half id, Elf64_Addr value);
+	s64 gotable_entry(size_t i);
 
 	bool exports_build(void);
 	int exports_count(void);
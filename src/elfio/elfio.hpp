@@ -46,6 +46,7 @@ THE SOFTWARE.
 #include <elfio/elfio_section.hpp>
 #include <elfio/elfio_segment.hpp>
 #include <elfio/elfio_strings.hpp>
+#include <elfio/elfio_mapping.hpp>
 
 #define ELFIO_HEADER_ACCESS_GET( TYPE, FNAME ) \
     TYPE get_##FNAME() const { return header ? ( header->get_##FNAME() ) : 0; }
@@ -105,34 +106,53 @@ class elfio
     {
         clean();
 
-        unsigned char e_ident[EI_NIDENT];
-        // Read ELF file signature
-        stream.read( reinterpret_cast<char*>( &e_ident ), sizeof( e_ident ) );
+        return load_image( stream );
+    }
 
-        // Is it ELF file?
-        if ( stream.gcount() != sizeof( e_ident ) ||
-             e_ident[EI_MAG0] != ELFMAG0 || e_ident[EI_MAG1] != ELFMAG1 ||
-             e_ident[EI_MAG2] != ELFMAG2 || e_ident[EI_MAG3] != ELFMAG3 ) {
-            return false;
-        }
+    //------------------------------------------------------------------------------
+    //! Maps the file instead of reading it. Section data points straight into
+    //! the mapping, pages are only copied by the kernel once written to.
+    //! Falls back to the lazy loader if the file can't be mapped.
+    bool load_mapped( const std::string& file_name )
+    {
+        clean();
 
-        if ( ( e_ident[EI_CLASS] != ELFCLASS64 ) &&
-             ( e_ident[EI_CLASS] != ELFCLASS32 ) ) {
-            return false;
+        if ( !mapping.open( file_name ) ) {
+            return load_lazy( file_name );
         }
 
-        convertor.setup( e_ident[EI_DATA] );
-        header = create_header( e_ident[EI_CLASS], e_ident[EI_DATA] );
-        if ( 0 == header ) {
-            return false;
+        // Only read ahead where we were told to look
+        if ( !prefetch.empty() ) {
+            mapping.advise_random();
         }
-        if ( !header->load( stream ) ) {
+
+        memory_streambuf buffer( mapping.get_data(), mapping.get_size() );
+        std::istream     stream( &buffer );
+
+        return load_image( stream );
+    }
+
+    //------------------------------------------------------------------------------
+    //! Parses all headers up front but keeps the file open and only reads the
+    //! data of a section the first time it is requested
+    bool load_lazy( const std::string& file_name )
+    {
+        clean();
+
+        lazy_file.open( file_name.c_str(), std::ios::in | std::ios::binary );
+        if ( !lazy_file ) {
             return false;
         }
 
-        load_sections( stream );
-        bool is_still_good = load_segments( stream );
-        return is_still_good;
+        return load_image( lazy_file );
+    }
+
+    //------------------------------------------------------------------------------
+    //! Sections named here are read right away by load_mapped and load_lazy,
+    //! the data of all others is only read on first use
+    void set_prefetch( const std::vector<std::string>& names )
+    {
+        prefetch = names;
     }
 
     //------------------------------------------------------------------------------
@@ -346,6 +366,11 @@ class elfio
             delete *it1;
         }
         segments_.clear();
+        mapping.close();
+        if ( lazy_file.is_open() ) {
+            lazy_file.close();
+        }
+        lazy_file.clear();
     }
 
     //------------------------------------------------------------------------------
@@ -429,6 +454,39 @@ class elfio
         shstrtab->set_addr_align( 1 );
     }
 
+    //------------------------------------------------------------------------------
+    bool load_image( std::istream& stream )
+    {
+        unsigned char e_ident[EI_NIDENT];
+        // Read ELF file signature
+        stream.read( reinterpret_cast<char*>( &e_ident ), sizeof( e_ident ) );
+
+        // Is it ELF file?
+        if ( stream.gcount() != sizeof( e_ident ) ||
+             e_ident[EI_MAG0] != ELFMAG0 || e_ident[EI_MAG1] != ELFMAG1 ||
+             e_ident[EI_MAG2] != ELFMAG2 || e_ident[EI_MAG3] != ELFMAG3 ) {
+            return false;
+        }
+
+        if ( ( e_ident[EI_CLASS] != ELFCLASS64 ) &&
+             ( e_ident[EI_CLASS] != ELFCLASS32 ) ) {
+            return false;
+        }
+
+        convertor.setup( e_ident[EI_DATA] );
+        header = create_header( e_ident[EI_CLASS], e_ident[EI_DATA] );
+        if ( 0 == header ) {
+            return false;
+        }
+        if ( !header->load( stream ) ) {
+            return false;
+        }
+
+        load_sections( stream );
+        bool is_still_good = load_segments( stream );
+        return is_still_good;
+    }
+
     //------------------------------------------------------------------------------
     Elf_Half load_sections( std::istream& stream )
     {
@@ -436,8 +494,15 @@ class elfio
         Elf_Half  num        = header->get_sections_num();
         Elf64_Off offset     = header->get_sections_offset();
 
+        // Measure the stream once rather than once per section
+        stream.seekg( 0, stream.end );
+        size_t stream_size = (size_t)stream.tellg();
+
         for ( Elf_Half i = 0; i < num; ++i ) {
             section* sec = create_section();
+            sec->set_stream_size( stream_size );
+            sec->set_mapping( mapping.get_data(), mapping.get_size() );
+            sec->set_lazy_stream( lazy_file.is_open() ? &stream : 0 );
             sec->load( stream, (std::streamoff)offset +
                                    (std::streampos)i * entry_size );
             sec->set_index( i );
@@ -459,6 +524,24 @@ class elfio
             }
         }
 
+        if ( !prefetch.empty() ) {
+            for ( Elf_Half i = 0; i < num; ++i ) {
+                section* sec = sections[i];
+                if ( std::find( prefetch.begin(), prefetch.end(),
+                                sec->get_name() ) == prefetch.end() ||
+                     SHT_NOBITS == sec->get_type() ) {
+                    continue;
+                }
+
+                if ( mapping.get_data() != 0 ) {
+                    mapping.advise_needed( sec->get_offset(), sec->get_size() );
+                }
+                else {
+                    sec->get_data();
+                }
+            }
+        }
+
         return num;
     }
 
@@ -979,6 +1062,9 @@ class elfio
     std::vector<section*> sections_;
     std::vector<segment*> segments_;
     endianess_convertor   convertor;
+    file_mapping          mapping;
+    std::ifstream         lazy_file;
+    std::vector<std::string> prefetch;
 
     Elf_Xword current_file_pos;
 };
@@ -0,0 +1,222 @@
+/*
+Copyright (C) 2001-present by Serge Lamikhov-Center
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef ELFIO_MAPPING_HPP
+#define ELFIO_MAPPING_HPP
+
+#include <string>
+#include <streambuf>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace ELFIO {
+
+//------------------------------------------------------------------------------
+// Private, copy-on-write view of a whole file. Pages are shared with the page
+// cache until something writes to them, the file itself is never modified.
+class file_mapping
+{
+  public:
+    //------------------------------------------------------------------------------
+    file_mapping() : data( 0 ), size( 0 ) {}
+
+    //------------------------------------------------------------------------------
+    ~file_mapping() { close(); }
+
+    //------------------------------------------------------------------------------
+    bool open( const std::string& file_name )
+    {
+        close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA( file_name.c_str(), GENERIC_READ,
+                                   FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL, NULL );
+        if ( file == INVALID_HANDLE_VALUE ) {
+            return false;
+        }
+
+        LARGE_INTEGER file_size;
+        if ( !GetFileSizeEx( file, &file_size ) || file_size.QuadPart == 0 ) {
+            CloseHandle( file );
+            return false;
+        }
+
+        HANDLE mapping =
+            CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+        CloseHandle( file );
+        if ( mapping == NULL ) {
+            return false;
+        }
+
+        data = static_cast<char*>(
+            MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 ) );
+        CloseHandle( mapping );
+        if ( data == 0 ) {
+            return false;
+        }
+
+        size = (size_t)file_size.QuadPart;
+#else
+        int fd = ::open( file_name.c_str(), O_RDONLY );
+        if ( fd < 0 ) {
+            return false;
+        }
+
+        struct stat st;
+        if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) ||
+             st.st_size == 0 ) {
+            ::close( fd );
+            return false;
+        }
+
+        void* view = mmap( 0, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE, fd, 0 );
+        ::close( fd );
+        if ( view == MAP_FAILED ) {
+            return false;
+        }
+
+        data = static_cast<char*>( view );
+        size = (size_t)st.st_size;
+#endif
+
+        return true;
+    }
+
+    //------------------------------------------------------------------------------
+    void close()
+    {
+        if ( data != 0 ) {
+#ifdef _WIN32
+            UnmapViewOfFile( data );
+#else
+            munmap( data, size );
+#endif
+        }
+
+        data = 0;
+        size = 0;
+    }
+
+    //------------------------------------------------------------------------------
+    //! Turns off read-ahead, pages are then only read when touched or advised
+    void advise_random()
+    {
+#ifndef _WIN32
+        if ( data != 0 ) {
+            madvise( data, size, MADV_RANDOM );
+        }
+#endif
+    }
+
+    //------------------------------------------------------------------------------
+    //! Starts reading a range in the background ahead of its first use
+    void advise_needed( size_t offset, size_t length )
+    {
+#ifndef _WIN32
+        if ( data == 0 || offset >= size || length == 0 ) {
+            return;
+        }
+
+        size_t page  = (size_t)sysconf( _SC_PAGESIZE );
+        size_t start = offset & ~( page - 1 );
+        size_t end   = std::min( offset + length, size );
+
+        madvise( data + start, end - start, MADV_WILLNEED );
+#endif
+    }
+
+    //------------------------------------------------------------------------------
+    char*  get_data() const { return data; }
+    size_t get_size() const { return size; }
+
+    //------------------------------------------------------------------------------
+  private:
+    file_mapping( const file_mapping& );
+    file_mapping& operator=( const file_mapping& );
+
+    char*  data;
+    size_t size;
+};
+
+//------------------------------------------------------------------------------
+// Seekable read-only stream buffer over a block of memory, used to parse the
+// headers of a mapped file through the regular istream based loaders
+class memory_streambuf : public std::streambuf
+{
+  public:
+    //------------------------------------------------------------------------------
+    memory_streambuf( char* data, size_t size ) { setg( data, data, data + size ); }
+
+    //------------------------------------------------------------------------------
+  protected:
+    //------------------------------------------------------------------------------
+    pos_type seekoff( off_type                off,
+                      std::ios_base::seekdir  dir,
+                      std::ios_base::openmode which = std::ios_base::in )
+    {
+        char* target = 0;
+
+        if ( dir == std::ios_base::beg ) {
+            target = eback() + off;
+        }
+        else if ( dir == std::ios_base::cur ) {
+            target = gptr() + off;
+        }
+        else {
+            target = egptr() + off;
+        }
+
+        if ( target < eback() || target > egptr() ) {
+            return pos_type( off_type( -1 ) );
+        }
+
+        setg( eback(), target, egptr() );
+        return pos_type( target - eback() );
+    }
+
+    //------------------------------------------------------------------------------
+    pos_type seekpos( pos_type                pos,
+                      std::ios_base::openmode which = std::ios_base::in )
+    {
+        return seekoff( off_type( pos ), std::ios_base::beg, which );
+    }
+};
+
+} // namespace ELFIO
+
+#endif // ELFIO_MAPPING_HPP
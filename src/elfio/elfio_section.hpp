@@ -61,6 +61,8 @@ class section
     ELFIO_SET_ACCESS_DECL( Elf64_Off, offset );
     ELFIO_SET_ACCESS_DECL( Elf_Half, index );
 
+    virtual void set_mapping( char* mapping, size_t mapping_size )          = 0;
+    virtual void set_lazy_stream( std::istream* stream )                     = 0;
     virtual void load( std::istream& stream, std::streampos header_offset ) = 0;
     virtual void save( std::ostream&  stream,
                        std::streampos header_offset,
@@ -82,10 +84,20 @@ template <class T> class section_impl : public section
         data_size      = 0;
         index          = 0;
         stream_size    = 0;
+        mapping        = 0;
+        mapping_size   = 0;
+        is_data_mapped = false;
+        lazy_stream     = 0;
+        is_data_pending = false;
     }
 
     //------------------------------------------------------------------------------
-    ~section_impl() { delete[] data; }
+    ~section_impl()
+    {
+        if ( !is_data_mapped ) {
+            delete[] data;
+        }
+    }
 
     //------------------------------------------------------------------------------
     // Section info functions
@@ -120,13 +132,25 @@ template <class T> class section_impl : public section
     bool is_address_initialized() const { return is_address_set; }
 
     //------------------------------------------------------------------------------
-    const char* get_data() const { return data; }
+    const char* get_data() const
+    {
+        if ( is_data_pending ) {
+            const_cast<section_impl*>( this )->load_pending();
+        }
+
+        return data;
+    }
 
     //------------------------------------------------------------------------------
     void set_data( const char* raw_data, Elf_Word size )
     {
+        is_data_pending = false;
+
         if ( get_type() != SHT_NOBITS ) {
-            delete[] data;
+            if ( !is_data_mapped ) {
+                delete[] data;
+            }
+            is_data_mapped = false;
             data = new ( std::nothrow ) char[size];
             if ( 0 != data && 0 != raw_data ) {
                 data_size = size;
@@ -149,8 +173,12 @@ template <class T> class section_impl : public section
     //------------------------------------------------------------------------------
     void append_data( const char* raw_data, Elf_Word size )
     {
+        if ( is_data_pending ) {
+            load_pending();
+        }
+
         if ( get_type() != SHT_NOBITS ) {
-            if ( get_size() + size < data_size ) {
+            if ( !is_data_mapped && get_size() + size < data_size ) {
                 std::copy( raw_data, raw_data + size, data + get_size() );
             }
             else {
@@ -161,8 +189,11 @@ template <class T> class section_impl : public section
                     std::copy( data, data + get_size(), new_data );
                     std::copy( raw_data, raw_data + size,
                                new_data + get_size() );
-                    delete[] data;
-                    data = new_data;
+                    if ( !is_data_mapped ) {
+                        delete[] data;
+                    }
+                    is_data_mapped = false;
+                    data           = new_data;
                 }
                 else {
                     size = 0;
@@ -192,29 +223,64 @@ template <class T> class section_impl : public section
         std::fill_n( reinterpret_cast<char*>( &header ), sizeof( header ),
                      '\0' );
 
-        stream.seekg( 0, stream.end );
-        set_stream_size( stream.tellg() );
+        if ( 0 == get_stream_size() ) {
+            stream.seekg( 0, stream.end );
+            set_stream_size( stream.tellg() );
+        }
 
         stream.seekg( header_offset );
         stream.read( reinterpret_cast<char*>( &header ), sizeof( header ) );
 
-        Elf_Xword size = get_size();
+        Elf_Xword size   = get_size();
+        Elf64_Off offset = ( *convertor )( header.sh_offset );
         if ( 0 == data && SHT_NULL != get_type() && SHT_NOBITS != get_type() &&
              size < get_stream_size() ) {
-            data = new ( std::nothrow ) char[size + 1];
-
-            if ( ( 0 != size ) && ( 0 != data ) ) {
-                stream.seekg( ( *convertor )( header.sh_offset ) );
-                stream.read( data, size );
-                data[size] = 0; // Ensure data is ended with 0 to avoid oob read
-                data_size  = size;
+            // Borrow from the mapping unless the section runs up to the end of
+            // the file, there is no terminating byte to guard reads there
+            if ( 0 != mapping && 0 != size && offset < mapping_size &&
+                 size < mapping_size - offset ) {
+                data           = mapping + offset;
+                data_size      = size;
+                is_data_mapped = true;
+                return;
             }
-            else {
-                data_size = 0;
+
+            // Lazy loads only read the data once it is asked for
+            if ( 0 != lazy_stream ) {
+                is_data_pending = true;
+                return;
             }
+
+            load_data( stream );
         }
     }
 
+    //------------------------------------------------------------------------------
+    void load_data( std::istream& stream )
+    {
+        Elf_Xword size = get_size();
+
+        data = new ( std::nothrow ) char[size + 1];
+
+        if ( ( 0 != size ) && ( 0 != data ) ) {
+            stream.clear();
+            stream.seekg( ( *convertor )( header.sh_offset ) );
+            stream.read( data, size );
+            data[size] = 0; // Ensure data is ended with 0 to avoid oob read
+            data_size  = size;
+        }
+        else {
+            data_size = 0;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    void load_pending()
+    {
+        is_data_pending = false;
+        load_data( *lazy_stream );
+    }
+
     //------------------------------------------------------------------------------
     void save( std::ostream&  stream,
                std::streampos header_offset,
@@ -249,6 +315,16 @@ template <class T> class section_impl : public section
         stream.write( get_data(), get_size() );
     }
 
+    //------------------------------------------------------------------------------
+    void set_mapping( char* mapping, size_t mapping_size )
+    {
+        this->mapping      = mapping;
+        this->mapping_size = mapping_size;
+    }
+
+    //------------------------------------------------------------------------------
+    void set_lazy_stream( std::istream* stream ) { lazy_stream = stream; }
+
     //------------------------------------------------------------------------------
     size_t get_stream_size() const { return stream_size; }
 
@@ -265,6 +341,11 @@ template <class T> class section_impl : public section
     const endianess_convertor* convertor;
     bool                       is_address_set;
     size_t                     stream_size;
+    char*                      mapping;
+    size_t                     mapping_size;
+    bool                       is_data_mapped;
+    std::istream*              lazy_stream;
+    bool                       is_data_pending;
 };
 
 } // namespace ELFIO
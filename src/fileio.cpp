@@ -0,0 +1,264 @@
+#include "fileio.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+bool file_read(const string& file, vector<u8>& data)
+{
+	ifstream in(file.c_str(), ios::in | ios::binary | ios::ate);
+	if (!in) return false;
+
+	streamoff size = in.tellg();
+	if (size < 0) return false;
+
+	data.resize((size_t) size);
+	in.seekg(0);
+
+	if (size && !in.read((char*) &data[0], size))
+		return false;
+
+	return true;
+}
+
+bool file_same(const string& file, const u8* data, size_t size)
+{
+	ifstream in(file.c_str(), ios::in | ios::binary | ios::ate);
+	if (!in) return false;
+
+	if (in.tellg() != (streamoff) size) return false;
+	in.seekg(0);
+
+	char buffer[0x4000];
+	size_t pos = 0;
+
+	while (pos < size)
+	{
+		size_t chunk = min(sizeof(buffer), size - pos);
+		if (!in.read(buffer, chunk)) return false;
+		if (memcmp(buffer, data + pos, chunk)) return false;
+		pos += chunk;
+	}
+
+	return true;
+}
+
+bool file_write(const string& file, const u8* data, size_t size)
+{
+	ofstream out(file.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!out) return false;
+
+	out.write((const char*) data, size);
+	out.close();
+
+	return !out.fail();
+}
+
+// leaves the file and its timestamp alone when it already holds these bytes,
+// otherwise writes aside and renames so it is never seen half written
+bool file_update(const string& file, const u8* data, size_t size)
+{
+	if (file_same(file, data, size))
+		return true;
+
+	string temp = file_temp(file);
+
+	if (!file_write(temp, data, size) || !file_rename(temp, file))
+	{
+		remove(temp.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool file_list(const string& dir, vector<string>& names)
+{
+	names.clear();
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+
+	do
+	{
+		if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			names.push_back(entry.cFileName);
+	}
+	while (FindNextFileA(find, &entry));
+
+	FindClose(find);
+#else
+	DIR* handle = opendir(dir.c_str());
+	if (!handle)
+		return false;
+
+	struct dirent* entry;
+	while ((entry = readdir(handle)) != NULL)
+	{
+		struct stat info;
+		string path = dir + "/" + entry->d_name;
+
+		if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+			names.push_back(entry->d_name);
+	}
+
+	closedir(handle);
+#endif
+
+	sort(names.begin(), names.end());
+	return true;
+}
+
+// a sibling name no other thread or process is using
+string file_temp(const string& file)
+{
+	static atomic<u32> counter(0);
+
+	// the counter tells threads apart, the process id processes writing the
+	// same output, as parallel builds sharing a cache do
+#ifdef _WIN32
+	int pid = _getpid();
+#else
+	int pid = (int) getpid();
+#endif
+
+	ostringstream temp;
+	temp << file << "." << pid << "." << counter++ << "." << chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+
+	return temp.str();
+}
+
+// replaces an existing destination atomically
+bool file_rename(const string& from, const string& to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+file_output::file_output() : data(NULL), size(0)
+{
+#ifdef _WIN32
+	handle = INVALID_HANDLE_VALUE;
+#else
+	fd = -1;
+#endif
+}
+
+u8* file_output::open(const string& file, size_t size)
+{
+	discard();
+	if (size == 0) return NULL;
+
+	this->file = file;
+	this->temp = file_temp(file);
+	this->size = size;
+
+#ifdef _WIN32
+	handle = CreateFileA(temp.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	// the mapping extends the new file, which reads back as zeroes
+	HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READWRITE, (DWORD) ((u64) size >> 32), (DWORD) size, NULL);
+	if (mapping != NULL)
+	{
+		data = (u8*) MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+		CloseHandle(mapping);
+	}
+#else
+	fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+	if (fd < 0)
+		return NULL;
+
+	// the blocks are reserved up front, a full disk then fails here rather
+	// than with SIGBUS on the first store, and they read back as zeroes
+	if (posix_fallocate(fd, 0, (off_t) size) == 0)
+	{
+		void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (view != MAP_FAILED)
+			data = (u8*) view;
+	}
+#endif
+
+	if (!data)
+		discard();
+
+	return data;
+}
+
+void file_output::close(void)
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+	handle = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap(data, size);
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+
+	data = NULL;
+}
+
+bool file_output::commit(void)
+{
+	if (!data) return false;
+
+	// an identical destination keeps its timestamp
+	bool same = file_same(file, data, size);
+
+	close();
+
+	if (same)
+	{
+		remove(temp.c_str());
+		temp.clear();
+		return true;
+	}
+
+	bool ret = file_rename(temp, file);
+	if (!ret) remove(temp.c_str());
+
+	temp.clear();
+	return ret;
+}
+
+void file_output::discard(void)
+{
+	close();
+
+	if (!temp.empty())
+		remove(temp.c_str());
+
+	temp.clear();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+bool file_read(const string& file, vector<u8>& data);
+bool file_same(const string& file, const u8* data, size_t size);
+bool file_write(const string& file, const u8* data, size_t size);
+bool file_update(const string& file, const u8* data, size_t size);
+
+// names of the plain files directly inside dir, sorted
+bool file_list(const string& dir, vector<string>& names);
+
+string file_temp(const string& file);
+bool file_rename(const string& from, const string& to);
+
+// a new file sized up front and written in place through a shared mapping,
+// it only appears under its final name once commit() succeeds; open() gives
+// NULL and leaves nothing behind when the space can't be had
+class file_output {
+public:
+	file_output();
+	~file_output() { discard(); }
+
+	u8* open(const string& file, size_t size);
+	bool commit(void);
+	void discard(void);
+
+	bool mapped(void) const { return data != NULL; }
+
+private:
+	file_output(const file_output&);
+	file_output& operator=(const file_output&);
+
+	string file;
+	string temp;
+	u8* data;
+	size_t size;
+
+#ifdef _WIN32
+	void* handle;
+#else
+	int fd;
+#endif
+
+	void close(void);
+};
@@ -0,0 +1,86 @@
+#include "gotable.hpp"
+
+#define GOT_EMPTY (-1)
+
+void dino_gotable::reset(size_t expected)
+{
+	entries.clear();
+	entries.reserve(expected);
+
+	// keep the load factor under one half
+	size_t capacity = 16;
+	while (capacity < expected * 2)
+		capacity <<= 1;
+
+	buckets.assign(capacity, GOT_EMPTY);
+	mask = (u32) (capacity - 1);
+}
+
+u32 dino_gotable::bucket(u32 address) const
+{
+	// fibonacci hashing, addresses are mostly small and word aligned
+	return ((address * 0x9E3779B1u) >> 7) & mask;
+}
+
+void dino_gotable::rehash(size_t capacity)
+{
+	buckets.assign(capacity, GOT_EMPTY);
+	mask = (u32) (capacity - 1);
+
+	for (size_t slot = 0; slot < entries.size(); slot++)
+	{
+		u32 i = bucket(entries[slot]);
+		while (buckets[i] != GOT_EMPTY)
+		{
+			// the first slot holding an address wins, as with a linear scan
+			if (entries[buckets[i]] == entries[slot]) break;
+			i = (i + 1) & mask;
+		}
+
+		if (buckets[i] == GOT_EMPTY)
+			buckets[i] = (s32) slot;
+	}
+}
+
+int dino_gotable::find(u32 address) const
+{
+	if (buckets.empty()) return -1;
+
+	u32 i = bucket(address);
+	while (buckets[i] != GOT_EMPTY)
+	{
+		if (entries[buckets[i]] == address)
+			return buckets[i];
+
+		i = (i + 1) & mask;
+	}
+
+	return -1;
+}
+
+int dino_gotable::append(u32 address)
+{
+	if (buckets.empty() || (entries.size() + 1) * 2 > buckets.size())
+		rehash(buckets.empty() ? 16 : buckets.size() * 2);
+
+	int slot = (int) entries.size();
+	entries.push_back(address);
+
+	u32 i = bucket(address);
+	while (buckets[i] != GOT_EMPTY)
+	{
+		if (entries[buckets[i]] == address) return slot;
+		i = (i + 1) & mask;
+	}
+
+	buckets[i] = slot;
+	return slot;
+}
+
+int dino_gotable::insert(u32 address)
+{
+	int slot = find(address);
+	if (slot >= 0) return slot;
+
+	return append(address);
+}
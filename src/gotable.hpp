@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+// GOT slots in emission order, indexed by target address through an
+// open-addressing hash so lookups stay O(1) however large the GOT grows
+class dino_gotable {
+public:
+	void reset(size_t expected);
+
+	int find(u32 address) const;
+	int insert(u32 address);
+	int append(u32 address);
+
+	size_t size(void) const { return entries.size(); }
+	u32 entry(int slot) const { return entries[slot]; }
+
+private:
+	vector<u32> entries;
+	vector<s32> buckets;
+	u32 mask;
+
+	u32 bucket(u32 address) const;
+	void rehash(size_t capacity);
+};
@@ -0,0 +1,108 @@
+#include "libelf2dll.h"
+#include "elf2dll.hpp"
+
+#include <sstream>
+#include <new>
+
+using namespace std;
+
+struct dino_result {
+	int status;
+	vector<u8> dll;
+	u32 bss;
+	string diag;
+};
+
+static void result_convert(dino_result* result, const vector<dino_span>& elf_images, const dino_options& options)
+{
+	ostringstream diag;
+	dino_dll dll(options, diag);
+
+	result->status = dll.build(elf_images, result->dll, result->bss);
+	result->diag = diag.str();
+
+	if (result->status)
+		result->dll.clear();
+}
+
+extern "C" dino_result* dino_convert(const unsigned char* const* elfs, const size_t* sizes, size_t count, unsigned int flags, const char* profile)
+{
+	dino_result* result = new (nothrow) dino_result;
+	if (!result) return NULL;
+
+	result->status = 1;
+	result->bss = 0;
+
+	// nothing may unwind into a C caller
+	try
+	{
+		if (!count || !elfs || !sizes)
+		{
+			result->diag = "No ELF objects to convert.\n";
+			return result;
+		}
+
+		dino_options options;
+		options.relax_calls = (flags & DINO_RELAX_CALLS) != 0;
+		options.relax_loads = (flags & DINO_RELAX_LOADS) != 0;
+		options.gc_sections = (flags & DINO_NO_GC_SECTIONS) == 0;
+		options.fold_code = (flags & DINO_ICF) != 0;
+		options.merge_constants = (flags & DINO_NO_MERGE_CONSTANTS) == 0;
+		if (profile) options.profile_file = profile;
+
+		vector<dino_span> elf_images(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			elf_images[i].data = elfs[i];
+			elf_images[i].size = sizes[i];
+		}
+
+		result_convert(result, elf_images, options);
+	}
+	catch (const exception& e)
+	{
+		result->status = 1;
+		result->dll.clear();
+		result->diag += string(e.what()) + "\n";
+	}
+	catch (...)
+	{
+		result->status = 1;
+		result->dll.clear();
+		result->diag += "Conversion failed.\n";
+	}
+
+	return result;
+}
+
+extern "C" int dino_result_status(const dino_result* result)
+{
+	return result ? result->status : 1;
+}
+
+extern "C" const unsigned char* dino_result_dll(const dino_result* result, size_t* size)
+{
+	if (!result || result->dll.empty())
+	{
+		if (size) *size = 0;
+		return NULL;
+	}
+
+	if (size) *size = result->dll.size();
+	return &result->dll[0];
+}
+
+extern "C" unsigned int dino_result_bss(const dino_result* result)
+{
+	return result ? result->bss : 0;
+}
+
+extern "C" const char* dino_result_diag(const dino_result* result)
+{
+	return result ? result->diag.c_str() : "";
+}
+
+extern "C" void dino_result_free(dino_result* result)
+{
+	delete result;
+}
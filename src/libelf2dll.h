@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// conversion flags, the same switches as the command line
+#define DINO_RELAX_CALLS         (1 << 0)
+#define DINO_RELAX_LOADS         (1 << 1)
+#define DINO_NO_GC_SECTIONS      (1 << 2)
+#define DINO_ICF                 (1 << 3)
+#define DINO_NO_MERGE_CONSTANTS  (1 << 4)
+
+// everything one conversion produced, owned by the library until freed
+typedef struct dino_result dino_result;
+
+// converts count ELF objects held in memory, linking them when there are
+// several, into a DLL held in memory; nothing is written to disk and calls
+// share no state, so any number may run at once. profile names a sample
+// file to lay .text out by, or is NULL. never returns NULL short of memory
+dino_result* dino_convert(const unsigned char* const* elfs, const size_t* sizes, size_t count, unsigned int flags, const char* profile);
+
+// 0 when the DLL was built, its bytes are only there then
+int dino_result_status(const dino_result* result);
+const unsigned char* dino_result_dll(const dino_result* result, size_t* size);
+unsigned int dino_result_bss(const dino_result* result);
+
+// the diagnostics the conversion printed, an empty string when there were none
+const char* dino_result_diag(const dino_result* result);
+
+void dino_result_free(dino_result* result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,312 @@
+#include "link.hpp"
+#include "elf2dll.hpp"
+
+#include <map>
+#include <sstream>
+
+using namespace std;
+using namespace ELFIO;
+
+// how strongly an object defines a global, the strongest one wins
+enum dino_definition {
+	DEFINITION_NONE,
+	DEFINITION_COMMON,
+	DEFINITION_WEAK,
+	DEFINITION_STRONG,
+};
+
+struct dino_global {
+	size_t object;
+	Elf_Xword symbol;
+	dino_definition definition;
+
+	Elf64_Addr value;
+	Elf_Xword size;
+	unsigned char bind;
+	unsigned char type;
+	unsigned char other;
+	Elf_Half section;
+};
+
+bool dino_linker::load(const string& elf_file, const vector<string>& prefetch)
+{
+	unique_ptr<elfio> object(new elfio());
+	object->set_prefetch(prefetch);
+
+	if (!object->load_mapped(elf_file))
+	{
+		diag << elf_file << " is not a valid ELF file." << endl;
+		return false;
+	}
+
+	return object_add(elf_file, move(object));
+}
+
+// in-memory objects go by their position among the inputs
+bool dino_linker::load(const u8* data, size_t size)
+{
+	ostringstream name;
+	name << "input " << objects.size();
+
+	unique_ptr<elfio> object(new elfio());
+	memory_streambuf buffer((char*) data, size);
+	istream stream(&buffer);
+
+	if (!object->load(stream))
+	{
+		diag << name.str() << " is not a valid ELF file." << endl;
+		return false;
+	}
+
+	return object_add(name.str(), move(object));
+}
+
+bool dino_linker::object_add(const string& name, unique_ptr<elfio> object)
+{
+	if (!objects.empty() && (object->get_class() != objects[0]->get_class() ||
+		object->get_encoding() != objects[0]->get_encoding() || object->get_machine() != objects[0]->get_machine()))
+	{
+		diag << name << " doesn't match the class and machine of " << files[0] << "." << endl;
+		return false;
+	}
+
+	files.push_back(name);
+	objects.push_back(move(object));
+
+	return true;
+}
+
+// only the object providing the exports contributes .exports, so only its
+// .rel.exports comes along
+bool dino_linker::link(elfio& out, size_t exports)
+{
+	if (objects.empty()) return false;
+
+	elfio& first = *objects[0];
+
+	out.create(first.get_class(), first.get_encoding());
+	out.set_os_abi(first.get_os_abi());
+	out.set_type(ET_REL);
+	out.set_machine(first.get_machine());
+	out.set_flags(first.get_flags());
+
+	sections_link(out, exports);
+
+	section* strtab = out.sections.add(".strtab");
+	strtab->set_type(SHT_STRTAB);
+	strtab->set_addr_align(1);
+
+	section* symtab = out.sections.add(".symtab");
+	symtab->set_type(SHT_SYMTAB);
+	symtab->set_addr_align(4);
+	symtab->set_entry_size(out.get_default_entry_size(SHT_SYMTAB));
+	symtab->set_link(strtab->get_index());
+
+	if (!symbols_link(out, symtab, strtab)) return false;
+
+	relocs_link(out, symtab);
+
+	// everything was copied, the inputs can go
+	objects.clear();
+
+	return true;
+}
+
+void dino_linker::sections_link(elfio& out, size_t exports)
+{
+	sections.resize(objects.size());
+
+	for (size_t o = 0; o < objects.size(); o++)
+	{
+		elfio& in = *objects[o];
+		sections[o].assign(in.sections.size(), SHN_UNDEF);
+
+		for (Elf_Half i = 1; i < in.sections.size(); i++)
+		{
+			section* sec = in.sections[i];
+
+			if (!(sec->get_flags() & SHF_ALLOC)) continue;
+			if (o != exports && sec->get_name() == ".exports") continue;
+
+			section* copy = out.sections.add(sec->get_name());
+			copy->set_type(sec->get_type());
+			copy->set_flags(sec->get_flags());
+			copy->set_addr_align(sec->get_addr_align());
+			copy->set_entry_size(sec->get_entry_size());
+
+			if (sec->get_type() == SHT_NOBITS || !sec->get_data())
+				copy->set_size(sec->get_size());
+			else
+				copy->set_data(sec->get_data(), (Elf_Word) sec->get_size());
+
+			sections[o][i] = copy->get_index();
+		}
+	}
+}
+
+section* dino_linker::object_symtab(size_t object)
+{
+	elfio& in = *objects[object];
+
+	for (Elf_Half i = 0; i < in.sections.size(); i++)
+	{
+		if (in.sections[i]->get_type() == SHT_SYMTAB)
+			return in.sections[i];
+	}
+
+	return NULL;
+}
+
+// sections that weren't carried over leave their symbols undefined
+Elf_Half dino_linker::section_index(size_t object, Elf_Half index)
+{
+	if (index == SHN_UNDEF || index >= SHN_LORESERVE) return index;
+	if (index >= sections[object].size()) return SHN_UNDEF;
+
+	return sections[object][index];
+}
+
+bool dino_linker::symbols_link(elfio& out, section* symtab, section* strtab)
+{
+	string_section_accessor strings(strtab);
+	symbol_section_accessor writer(out, symtab);
+
+	map<string, size_t> names;
+	vector<dino_global> globals;
+	vector<string> order;
+	bool ret = true;
+
+	string name;
+	Elf64_Addr value = 0; Elf_Xword size = 0; Elf_Half index = 0;
+	unsigned char bind = 0, type = 0, other = 0;
+
+	// locals first, as the format wants, globals gathered on the way
+	symbols.resize(objects.size());
+
+	for (size_t o = 0; o < objects.size(); o++)
+	{
+		section* sec = object_symtab(o);
+		if (!sec) continue;
+
+		symbol_section_accessor reader(*objects[o], sec);
+		Elf_Xword count = reader.get_symbols_num();
+		symbols[o].assign((size_t) count, 0);
+
+		for (Elf_Xword j = 1; j < count; j++)
+		{
+			reader.get_symbol(j, name, value, size, bind, type, index, other);
+
+			if (bind == STB_LOCAL)
+			{
+				symbols[o][j] = writer.add_symbol(strings, name.c_str(), value, size, bind, type, other, section_index(o, index));
+				continue;
+			}
+
+			dino_definition definition = DEFINITION_STRONG;
+			if (index == SHN_UNDEF) definition = DEFINITION_NONE;
+			else if (index == SHN_COMMON || index == SHN_MIPS_SCOMMON) definition = DEFINITION_COMMON;
+			else if (bind == STB_WEAK) definition = DEFINITION_WEAK;
+
+			dino_global global = { o, j, definition, value, size, bind, type, other, section_index(o, index) };
+
+			map<string, size_t>::iterator found = names.find(name);
+			if (found == names.end())
+			{
+				names[name] = globals.size();
+				globals.push_back(global);
+				order.push_back(name);
+				continue;
+			}
+
+			dino_global& known = globals[found->second];
+
+			if (definition == DEFINITION_STRONG && known.definition == DEFINITION_STRONG)
+			{
+				diag << "Symbol \"" << name << "\" is defined in both " << files[known.object] << " and " << files[o] << "." << endl;
+				ret = false;
+				continue;
+			}
+
+			// commons take the largest size and alignment of them all
+			if (definition == DEFINITION_COMMON && known.definition == DEFINITION_COMMON)
+			{
+				known.value = max(known.value, value);
+				known.size = max(known.size, size);
+				if (index == SHN_COMMON) known.section = SHN_COMMON;
+				continue;
+			}
+
+			if (definition > known.definition)
+				known = global;
+		}
+	}
+
+	symtab->set_info((Elf_Word) (symtab->get_size() / symtab->get_entry_size()));
+
+	vector<Elf_Word> emitted(globals.size());
+	for (size_t g = 0; g < globals.size(); g++)
+	{
+		const dino_global& global = globals[g];
+		emitted[g] = writer.add_symbol(strings, order[g].c_str(), global.value, global.size, global.bind, global.type, global.other, global.section);
+	}
+
+	// every object's references follow to the one symbol kept per name
+	for (size_t o = 0; o < objects.size(); o++)
+	{
+		section* sec = object_symtab(o);
+		if (!sec) continue;
+
+		symbol_section_accessor reader(*objects[o], sec);
+
+		for (Elf_Xword j = 1; j < symbols[o].size(); j++)
+		{
+			reader.get_symbol(j, name, value, size, bind, type, index, other);
+			if (bind != STB_LOCAL)
+				symbols[o][j] = emitted[names[name]];
+		}
+	}
+
+	return ret;
+}
+
+void dino_linker::relocs_link(elfio& out, section* symtab)
+{
+	Elf64_Addr offset = 0; Elf_Word symbol = 0, type = 0; Elf_Sxword addend = 0;
+
+	for (size_t o = 0; o < objects.size(); o++)
+	{
+		elfio& in = *objects[o];
+
+		for (Elf_Half i = 1; i < in.sections.size(); i++)
+		{
+			section* sec = in.sections[i];
+			if (sec->get_type() != SHT_REL && sec->get_type() != SHT_RELA) continue;
+
+			Elf_Half target = section_index(o, (Elf_Half) sec->get_info());
+			if (target == SHN_UNDEF || target >= SHN_LORESERVE) continue;
+
+			section* copy = out.sections.add(sec->get_name());
+			copy->set_type(sec->get_type());
+			copy->set_flags(sec->get_flags());
+			copy->set_addr_align(sec->get_addr_align());
+			copy->set_entry_size(out.get_default_entry_size(sec->get_type()));
+			copy->set_link(symtab->get_index());
+			copy->set_info(target);
+
+			relocation_section_accessor reader(in, sec);
+			relocation_section_accessor writer(out, copy);
+			Elf_Xword entries = reader.get_entries_num();
+
+			for (Elf_Xword k = 0; k < entries; k++)
+			{
+				reader.get_entry(k, offset, symbol, type, addend);
+				if (symbol < symbols[o].size()) symbol = symbols[o][symbol];
+
+				if (sec->get_type() == SHT_RELA)
+					writer.add_entry(offset, symbol, (unsigned char) type, addend);
+				else
+					writer.add_entry(offset, symbol, (unsigned char) type);
+			}
+		}
+	}
+}
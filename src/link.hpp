@@ -0,0 +1,41 @@
+#pragma once
+
+#include <elfio/elfio.hpp>
+#include <memory>
+#include "types.h"
+
+using namespace std;
+using namespace ELFIO;
+
+// the part of "ld -r" the converter needs, done in memory: allocated
+// sections and their relocations are carried over whole, locals stay with
+// their object and globals resolve by name across all of them
+class dino_linker {
+public:
+	dino_linker(ostream& diag = cerr) : diag(diag) {}
+
+	bool load(const string& elf_file, const vector<string>& prefetch);
+	bool load(const u8* data, size_t size);
+	bool link(elfio& out, size_t exports);
+
+	size_t size(void) const { return objects.size(); }
+
+private:
+	ostream& diag;
+
+	vector<string> files;
+	vector<unique_ptr<elfio> > objects;
+
+	// new index of every input section and symbol, per object
+	vector<vector<Elf_Half> > sections;
+	vector<vector<Elf_Word> > symbols;
+
+	void sections_link(elfio& out, size_t exports);
+	bool symbols_link(elfio& out, section* symtab, section* strtab);
+	void relocs_link(elfio& out, section* symtab);
+
+	bool object_add(const string& name, unique_ptr<elfio> object);
+
+	section* object_symtab(size_t object);
+	Elf_Half section_index(size_t object, Elf_Half index);
+};
@@ -0,0 +1,273 @@
+#include "loader.hpp"
+#include "elf2dll.hpp"
+#include "utils.h"
+
+#include <sstream>
+#include <cstring>
+
+using namespace std;
+
+// unused GOT slots stay as the converter left them, and the loader adds the
+// base to them all the same
+#define LOAD_UNUSED         (0xFFFFFFFF)
+
+// a GOT page may land half a page either side of what it covers
+#define LOAD_PAGE_SLACK     (0x8000)
+
+u32 dino_loader::read(u32 address)
+{
+	u32 offset = address - base;
+	lines[offset / LOAD_DCACHE_LINE] = 1;
+
+	return getbe32(&rdram[address - DINO_RDRAM_BASE]);
+}
+
+void dino_loader::write(u32 address, u32 value)
+{
+	u32 offset = address - base;
+	lines[offset / LOAD_DCACHE_LINE] = 1;
+	words++;
+
+	putbe32(&rdram[address - DINO_RDRAM_BASE], value);
+}
+
+bool dino_loader::within(u32 address, u32 slack)
+{
+	return (u64) address + slack >= text && (u64) address <= (u64) end + slack;
+}
+
+bool dino_loader::load(const u8* image, size_t size, u32 bss, u32 address)
+{
+	ostringstream where;
+	where << "0x" << hex << address;
+
+	stats.reset("", where.str());
+	stats.result = 1;
+
+	if (rdram.empty())
+		rdram.assign(DINO_RDRAM_SIZE, 0);
+
+	dino_timer timer(stats, "load");
+
+	if (size < sizeof(dino_dll_header))
+	{
+		diag << "Not a DLL, " << size << " bytes is shorter than its header." << endl;
+		return false;
+	}
+
+	if (address < DINO_RDRAM_BASE || (address & 0xF) != 0 ||
+		(u64) address - DINO_RDRAM_BASE + size + bss > DINO_RDRAM_SIZE)
+	{
+		diag << "A DLL of 0x" << hex << size << " bytes and 0x" << bss << " bytes of .bss doesn't fit RDRAM at 0x" << address << dec << "." << endl;
+		return false;
+	}
+
+	const dino_dll_header* header = (const dino_dll_header*) image;
+	u32 header_size = getbe32(header->header_size);
+	u32 data_offset = getbe32(header->data_offset);
+	u32 table_offset = getbe32(header->rodata_offset);
+	int export_count = (int) getbe16(header->export_count);
+
+	if (header_size > size || sizeof(dino_dll_header) + (export_count + 4) * sizeof(u32) > header_size ||
+		(data_offset != DINO_NONE && (data_offset < header_size || data_offset > size)) ||
+		(table_offset != DINO_NONE && (table_offset < header_size || table_offset > size)))
+	{
+		diag << "The header doesn't describe a DLL of 0x" << hex << size << dec << " bytes." << endl;
+		return false;
+	}
+
+	base = address;
+	text = address + header_size;
+	end = address + (u32) size + bss;
+
+	words = 0;
+	lines.assign((size + bss) / LOAD_DCACHE_LINE + 1, 0);
+
+	// RDRAM starts out zeroed, afterwards only the previous DLL is cleared
+	if (used_size)
+		memset(&rdram[used - DINO_RDRAM_BASE], 0, used_size);
+
+	used = address;
+	used_size = (u32) size + bss;
+
+	// the cartridge DMA brings the image in, the CPU clears .bss behind it
+	u8* memory = &rdram[address - DINO_RDRAM_BASE];
+	memcpy(memory, image, size);
+	memset(memory + size, 0, bss);
+
+	u32 text_size = (table_offset != DINO_NONE ? table_offset : data_offset != DINO_NONE ? data_offset : (u32) size) - header_size;
+
+	bool ret = exports_load(export_count);
+
+	if (table_offset != DINO_NONE)
+	{
+		u32 entry = address + table_offset;
+		u32 data = data_offset != DINO_NONE ? address + data_offset : end;
+
+		ret = gotable_load(entry) && ret;
+		ret = gptable_load(entry, address + table_offset, text_size) && ret;
+		ret = datable_load(entry, data, data_offset != DINO_NONE ? (u32) size - data_offset : 0) && ret;
+	}
+
+	u64 touched = 0;
+	for (size_t i = 0; i < lines.size(); i++)
+		touched += lines[i];
+
+	// the patched code has to leave the instruction cache before it runs
+	u64 invalidated = (text_size + LOAD_ICACHE_LINE - 1) / LOAD_ICACHE_LINE;
+
+	u64 dma = (u64) size * LOAD_DMA_CYCLES;
+	u64 relocation = words * LOAD_WORD_CYCLES + touched * LOAD_LINE_CYCLES + invalidated * LOAD_INVAL_CYCLES;
+	u64 clear = (u64) (bss + sizeof(u32) - 1) / sizeof(u32) * LOAD_CLEAR_CYCLES;
+
+	stats.count("image bytes", size);
+	stats.count("bss bytes", bss);
+	stats.count("words touched", words);
+	stats.count("lines touched", touched);
+	stats.count("dma cycles", dma);
+	stats.count("relocation cycles", relocation);
+	stats.count("clear cycles", clear);
+	stats.count("estimated cycles", dma + relocation + clear);
+
+	stats.result = ret ? 0 : 1;
+	return ret;
+}
+
+// constructor, destructor and exports hold .text offsets, the word between
+// the destructor and the exports is left alone
+bool dino_loader::exports_load(int count)
+{
+	bool ret = true;
+	u32 entry = base + sizeof(dino_dll_header);
+
+	for (int i = 0; i < count + 3; i++, entry += sizeof(u32))
+	{
+		if (i == 2) continue;
+
+		u32 value = read(entry);
+		if (value >= end - text)
+		{
+			diag << "Export " << i << " at 0x" << hex << value << dec << " is outside the DLL." << endl;
+			ret = false;
+		}
+
+		write(entry, value + text);
+	}
+
+	stats.count("export entries", count + 2);
+
+	return ret;
+}
+
+bool dino_loader::gotable_load(u32& entry)
+{
+	bool ret = true;
+	int slot = 0;
+
+	for (; entry + sizeof(u32) <= end; entry += sizeof(u32), slot++)
+	{
+		u32 value = read(entry);
+		if (value == DINO_GOTEND) break;
+
+		bool unused = value == LOAD_UNUSED;
+		value += text;
+		write(entry, value);
+
+		if (unused) continue;
+
+		// the four section bases come first and fall inside the DLL
+		if ((slot == 0 && value != text) || (slot < 4 && !within(value, 0)) || !within(value, LOAD_PAGE_SLACK))
+		{
+			diag << "GOT slot " << slot << " holds 0x" << hex << value << dec << ", outside the DLL." << endl;
+			ret = false;
+		}
+	}
+
+	if (entry + sizeof(u32) > end)
+	{
+		diag << "The GOT runs off the end of the DLL." << endl;
+		return false;
+	}
+
+	entry += sizeof(u32);
+	stats.count("got entries", slot);
+
+	return ret;
+}
+
+// "lui $gp; ori $gp" take the absolute address of the GOT, where the
+// converter left them with zero immediates
+bool dino_loader::gptable_load(u32& entry, u32 gp, u32 text_size)
+{
+	bool ret = true;
+	int count = 0;
+
+	for (; entry + sizeof(u32) <= end; entry += sizeof(u32), count++)
+	{
+		u32 offset = read(entry);
+		if (offset == DINO_GPTEND) break;
+
+		if ((offset & 3) != 0 || (u64) offset + 2 * sizeof(u32) > text_size ||
+			(read(text + offset) & ~MIPS_IMMMASK) != MIPS_LUI_GP_I16 ||
+			(read(text + offset + sizeof(u32)) & ~MIPS_IMMMASK) != MIPS_ORI_GP_I16)
+		{
+			diag << "$gp table entry " << count << " at .text+0x" << hex << offset << dec << " isn't a $gp setup." << endl;
+			ret = false;
+			continue;
+		}
+
+		write(text + offset, MIPS_LUI_GP_I16 | (gp >> 16));
+		write(text + offset + sizeof(u32), MIPS_ORI_GP_I16 | (gp & MIPS_IMMMASK));
+	}
+
+	if (entry + sizeof(u32) > end)
+	{
+		diag << "The $gp table runs off the end of the DLL." << endl;
+		return false;
+	}
+
+	entry += sizeof(u32);
+	stats.count("gp stubs", count);
+
+	return ret;
+}
+
+// .data words hold offsets from the start of .data
+bool dino_loader::datable_load(u32& entry, u32 data, u32 data_size)
+{
+	bool ret = true;
+	int count = 0;
+
+	for (; entry + sizeof(u32) <= end; entry += sizeof(u32), count++)
+	{
+		u32 offset = read(entry);
+		if (offset == DINO_DATEND) break;
+
+		if ((offset & 3) != 0 || (u64) offset + sizeof(u32) > data_size)
+		{
+			diag << ".data table entry " << count << " at .data+0x" << hex << offset << dec << " is outside .data." << endl;
+			ret = false;
+			continue;
+		}
+
+		u32 value = read(data + offset) + data;
+		write(data + offset, value);
+
+		if (!within(value, 0))
+		{
+			diag << ".data+0x" << hex << offset << " points to 0x" << value << dec << ", outside the DLL." << endl;
+			ret = false;
+		}
+	}
+
+	if (entry + sizeof(u32) > end)
+	{
+		diag << "The .data table runs off the end of the DLL." << endl;
+		return false;
+	}
+
+	entry += sizeof(u32);
+	stats.count("data words", count);
+
+	return ret;
+}
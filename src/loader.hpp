@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include "types.h"
+#include "stats.hpp"
+
+using namespace std;
+
+// RDRAM with the expansion pak, and where the simulated loader puts a DLL
+#define DINO_RDRAM_BASE     (0x80000000)
+#define DINO_RDRAM_SIZE     (0x800000)
+#define DINO_LOAD_ADDRESS   (0x80400000)
+
+// a rough R4300 cost model at 93.75 MHz: the cartridge DMA moves about
+// 5 MB/s, a relocated word is a load, add, store and loop branch, and the
+// first touch of a 16-byte line misses the data cache
+#define LOAD_DMA_CYCLES     (19)
+#define LOAD_WORD_CYCLES    (6)
+#define LOAD_LINE_CYCLES    (40)
+#define LOAD_CLEAR_CYCLES   (2)
+#define LOAD_INVAL_CYCLES   (1)
+
+#define LOAD_DCACHE_LINE    (16)
+#define LOAD_ICACHE_LINE    (32)
+
+// the game's DLL loader redone on the host: the image is copied into a
+// simulated RDRAM, .bss cleared, then the exports, GOT, $gp setups and
+// .data words relocated exactly as the tables say, checking every entry.
+// RDRAM lives as long as the loader, so one loader may take any number of
+// DLLs in turn
+class dino_loader {
+public:
+	dino_loader(ostream& diag = cerr) : diag(diag), used(0), used_size(0) {}
+
+	bool load(const u8* image, size_t size, u32 bss, u32 address = DINO_LOAD_ADDRESS);
+
+	const dino_stats& get_stats(void) const { return stats; }
+
+private:
+	ostream& diag;
+	dino_stats stats;
+	vector<u8> rdram;
+
+	// what the last DLL covered, the next load clears it
+	u32 used;
+	u32 used_size;
+
+	u32 base;
+	u32 text;
+	u32 end;
+
+	u64 words;
+	vector<u8> lines;
+
+	u32 read(u32 address);
+	void write(u32 address, u32 value);
+	bool within(u32 address, u32 slack);
+
+	bool exports_load(int count);
+	bool gotable_load(u32& address);
+	bool gptable_load(u32& address, u32 gp, u32 text_size);
+	bool datable_load(u32& address, u32 data, u32 data_size);
+};
@@ -1,13 +1,179 @@
 #include "elf2dll.hpp"
+#include "dll2elf.hpp"
+#include "batch.hpp"
+#include "verify.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+static int usage(const char* argv0)
+{
+	cerr << "Usage: " << argv0 << " [options] <input-elf>... <output-dll>" << endl;
+	cerr << "       " << argv0 << " [options] --batch <manifest>" << endl;
+	cerr << "       " << argv0 << " [options] --bundle <manifest> <bank> <index>" << endl;
+	cerr << "       " << argv0 << " --dll2elf <input-dll> <output-elf>" << endl;
+	cerr << "       " << argv0 << " --dll2elf --batch <manifest>" << endl;
+	cerr << "       " << argv0 << " --dll2elf --bundle <bank> <index> <output-dir>" << endl;
+	cerr << "       " << argv0 << " [--stats[=json]] --simulate <input-dll>..." << endl;
+	cerr << "       " << argv0 << " [--stats[=json]] --simulate --bundle <bank> <index>" << endl;
+	cerr << "       " << argv0 << " --verify <reference-dir> <output-dir>" << endl;
+	cerr << "       " << argv0 << " [options] --verify <reference-dir> --batch <manifest>" << endl;
+	cerr << endl;
+	cerr << "Several input objects are linked together, the first one provides the exports." << endl;
+	cerr << "--dll2elf takes DLLs back apart into relocatable ELF files." << endl;
+	cerr << "--simulate loads DLLs as the game would and ranks them by load cost." << endl;
+	cerr << "--verify compares DLLs with the reference ones of the same name." << endl;
+	cerr << endl;
+	cerr << "Options:" << endl;
+	cerr << "  --jobs <n>     number of worker threads for --batch and --bundle" << endl;
+	cerr << "  --cache <dir>  reuse DLLs converted earlier from identical inputs" << endl;
+	cerr << "  --stats[=json] report time per phase and conversion counters" << endl;
+	cerr << "  --relax-calls  turn calls to local functions into direct branches" << endl;
+	cerr << "  --relax-loads  address local data from $gp instead of through the GOT" << endl;
+	cerr << "  --no-gc-sections keep .text.*/.data.* sections the exports never reach" << endl;
+	cerr << "  --icf          fold byte-identical functions into one copy" << endl;
+	cerr << "  --no-merge-constants keep duplicate SHF_MERGE strings and constants" << endl;
+	cerr << "  --profile <file> order .text by \"<symbol> <samples>\" lines, hottest first" << endl;
+	return 1;
+}
 
 int main(int argc, const char* argv[])
 {
-	if (argc < 3)
+	dino_options options;
+	vector<string> args;
+	string manifest;
+	bool bundle = false;
+	bool reverse = false;
+	bool simulate = false;
+	string reference;
+	unsigned threads = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool more = i + 1 < argc;
+
+		if (!strcmp(argv[i], "--batch") && more)
+			manifest = argv[++i];
+		else if (!strcmp(argv[i], "--bundle") && more)
+		{
+			manifest = argv[++i];
+			bundle = true;
+		}
+		else if (!strcmp(argv[i], "--dll2elf"))
+			reverse = true;
+		else if (!strcmp(argv[i], "--simulate"))
+			simulate = true;
+		else if (!strcmp(argv[i], "--verify") && more)
+			reference = argv[++i];
+		else if (!strcmp(argv[i], "--jobs") && more)
+			threads = (unsigned) atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--cache") && more)
+			options.cache_dir = argv[++i];
+		else if (!strcmp(argv[i], "--stats") || !strcmp(argv[i], "--stats=text"))
+			options.stats = STATS_TEXT;
+		else if (!strcmp(argv[i], "--stats=json"))
+			options.stats = STATS_JSON;
+		else if (!strcmp(argv[i], "--relax-calls"))
+			options.relax_calls = true;
+		else if (!strcmp(argv[i], "--relax-loads"))
+			options.relax_loads = true;
+		else if (!strcmp(argv[i], "--no-gc-sections"))
+			options.gc_sections = false;
+		else if (!strcmp(argv[i], "--icf"))
+			options.fold_code = true;
+		else if (!strcmp(argv[i], "--no-merge-constants"))
+			options.merge_constants = false;
+		else if (!strcmp(argv[i], "--profile") && more)
+			options.profile_file = argv[++i];
+		else if (!strncmp(argv[i], "--", 2))
+			return usage(argv[0]);
+		else
+			args.push_back(argv[i]);
+	}
+
+	if (!reference.empty())
+	{
+		if (!bundle && !manifest.empty() && args.empty())
+		{
+			vector<dino_job> jobs;
+			if (!batch_manifest(manifest, jobs))
+				return 1;
+
+			return verify_jobs(jobs, reference, options, threads);
+		}
+
+		if (!manifest.empty() || args.size() != 1)
+			return usage(argv[0]);
+
+		return verify_dirs(args[0], reference, threads);
+	}
+
+	if (simulate)
+	{
+		if (bundle && args.size() == 1)
+			return batch_simulate(manifest, args[0], options, threads);
+
+		if (!manifest.empty() || args.empty())
+			return usage(argv[0]);
+
+		return batch_simulate(args, options, threads);
+	}
+
+	if (reverse)
+	{
+		if (bundle && args.size() == 2)
+			return batch_unbundle(manifest, args[0], args[1], threads);
+
+		if (!bundle && !manifest.empty() && args.empty())
+		{
+			vector<dino_job> jobs;
+			if (!batch_manifest(manifest, jobs))
+				return 1;
+
+			return batch_dll2elf(jobs, threads);
+		}
+
+		if (!manifest.empty() || args.size() != 2)
+			return usage(argv[0]);
+
+		dino_elf elf;
+		return elf.build(args[0], args[1]);
+	}
+
+	if (bundle)
 	{
-		cerr << "Usage: " << argv[0] << " <input-elf> <output-dll>" << endl;
-		return 1;
+		if (args.size() != 2)
+			return usage(argv[0]);
+
+		vector<dino_job> jobs;
+		if (!batch_manifest(manifest, jobs, false))
+			return 1;
+
+		return batch_bundle(jobs, options, threads, args[0], args[1]);
 	}
 
-	dino_dll dll;
-	return dll.build(argv[1], argv[2]);
+	if (!manifest.empty())
+	{
+		if (!args.empty())
+			return usage(argv[0]);
+
+		vector<dino_job> jobs;
+		if (!batch_manifest(manifest, jobs))
+			return 1;
+
+		return batch_build(jobs, options, threads);
+	}
+
+	if (args.size() < 2)
+		return usage(argv[0]);
+
+	string dll_file = args.back();
+	args.pop_back();
+
+	dino_dll dll(options);
+	int ret = dll.build(args, dll_file);
+
+	dll.get_stats().print(cout, options.stats);
+
+	return ret;
 }
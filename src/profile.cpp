@@ -0,0 +1,59 @@
+#include "profile.hpp"
+#include "fileio.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include "utils.h"
+
+using namespace std;
+
+bool profile_read(const string& profile_file, dino_profile& profile, ostream& diag)
+{
+	ifstream in(profile_file.c_str());
+	if (!in)
+	{
+		diag << "Unable to open profile " << profile_file << "." << endl;
+		return false;
+	}
+
+	string line;
+	int number = 0;
+
+	while (getline(in, line))
+	{
+		number++;
+
+		size_t comment = line.find('#');
+		if (comment != string::npos) line.erase(comment);
+
+		istringstream fields(line);
+		string symbol, extra;
+		u64 samples = 0;
+
+		if (!(fields >> symbol)) continue;
+
+		if (!(fields >> samples) || (fields >> extra))
+		{
+			diag << profile_file << ":" << number << ": expected <symbol> <samples>." << endl;
+			return false;
+		}
+
+		profile[symbol] += samples;
+	}
+
+	return true;
+}
+
+// the profile changes the output, so its contents go into the cache key
+string profile_key(const string& profile_file)
+{
+	vector<u8> data;
+	if (!file_read(profile_file, data)) return "?";
+
+	ostringstream key;
+	key << hex << setw(16) << setfill('0') << hash64(data.empty() ? NULL : &data[0], data.size(), 0);
+
+	return key.str();
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <iostream>
+#include "types.h"
+
+using namespace std;
+
+// function hotness from a PC sampler, one "<symbol> <samples>" per line
+typedef map<string, u64> dino_profile;
+
+bool profile_read(const string& profile_file, dino_profile& profile, ostream& diag);
+string profile_key(const string& profile_file);
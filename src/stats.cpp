@@ -0,0 +1,168 @@
+#include "stats.hpp"
+
+#include <iomanip>
+
+using namespace std;
+
+void dino_stats::reset(const string& elf_file, const string& dll_file)
+{
+	this->elf_file = elf_file;
+	this->dll_file = dll_file;
+	result = 0;
+
+	phases.clear();
+	counters.clear();
+}
+
+void dino_stats::phase(const string& name, double seconds)
+{
+	for (size_t i = 0; i < phases.size(); i++)
+	{
+		if (phases[i].first != name) continue;
+
+		phases[i].second += seconds;
+		return;
+	}
+
+	phases.push_back(make_pair(name, seconds));
+}
+
+void dino_stats::count(const string& name, u64 value)
+{
+	for (size_t i = 0; i < counters.size(); i++)
+	{
+		if (counters[i].first != name) continue;
+
+		counters[i].second += value;
+		return;
+	}
+
+	counters.push_back(make_pair(name, value));
+}
+
+u64 dino_stats::counter(const string& name) const
+{
+	for (size_t i = 0; i < counters.size(); i++)
+	{
+		if (counters[i].first == name)
+			return counters[i].second;
+	}
+
+	return 0;
+}
+
+double dino_stats::total(void) const
+{
+	double seconds = 0;
+	for (size_t i = 0; i < phases.size(); i++)
+		seconds += phases[i].second;
+
+	return seconds;
+}
+
+void dino_stats::print(ostream& out, dino_stats_format format) const
+{
+	switch (format)
+	{
+		case STATS_TEXT:
+			print_text(out);
+			break;
+
+		case STATS_JSON:
+			print_json(out);
+			out << endl;
+			break;
+
+		default:
+			break;
+	}
+}
+
+void dino_stats::print_text(ostream& out) const
+{
+	out << elf_file << " -> " << dll_file << (result ? " (failed)" : "") << endl;
+
+	ios::fmtflags flags = out.flags();
+	out << fixed << setprecision(3);
+
+	for (size_t i = 0; i < phases.size(); i++)
+		out << "  " << left << setw(24) << phases[i].first << right << setw(10) << phases[i].second * 1000.0 << " ms" << endl;
+	out << "  " << left << setw(24) << "total" << right << setw(10) << total() * 1000.0 << " ms" << endl;
+
+	for (size_t i = 0; i < counters.size(); i++)
+		out << "  " << left << setw(24) << counters[i].first << right << setw(10) << counters[i].second << endl;
+
+	out.flags(flags);
+}
+
+static void json_string(ostream& out, const string& text)
+{
+	out << '"';
+
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		unsigned char c = (unsigned char) text[i];
+
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c < 0x20)
+			out << "\\u" << hex << setw(4) << setfill('0') << (int) c << dec << setfill(' ');
+		else
+			out << c;
+	}
+
+	out << '"';
+}
+
+void dino_stats::print_json(ostream& out) const
+{
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << setprecision(9);
+
+	out << "{\"elf\": ";
+	json_string(out, elf_file);
+	out << ", \"dll\": ";
+	json_string(out, dll_file);
+	out << ", \"result\": " << result;
+
+	out << ", \"phases\": {";
+	for (size_t i = 0; i < phases.size(); i++)
+	{
+		if (i) out << ", ";
+		json_string(out, phases[i].first);
+		out << ": " << phases[i].second;
+	}
+	out << "}, \"total\": " << total();
+
+	out << ", \"counters\": {";
+	for (size_t i = 0; i < counters.size(); i++)
+	{
+		if (i) out << ", ";
+		json_string(out, counters[i].first);
+		out << ": " << counters[i].second;
+	}
+	out << "}}";
+
+	out.precision(precision);
+	out.flags(flags);
+}
+
+void stats_print_all(ostream& out, const vector<dino_stats>& stats, dino_stats_format format)
+{
+	if (format != STATS_JSON)
+	{
+		for (size_t i = 0; i < stats.size(); i++)
+			stats[i].print(out, format);
+		return;
+	}
+
+	out << "[" << endl;
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		out << "  ";
+		stats[i].print_json(out);
+		out << (i + 1 < stats.size() ? "," : "") << endl;
+	}
+	out << "]" << endl;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include "types.h"
+
+using namespace std;
+
+enum dino_stats_format {
+	STATS_NONE,
+	STATS_TEXT,
+	STATS_JSON,
+};
+
+// wall time per conversion phase plus named counters, in recording order
+class dino_stats {
+public:
+	string elf_file;
+	string dll_file;
+	int result;
+
+	void reset(const string& elf_file, const string& dll_file);
+
+	void phase(const string& name, double seconds);
+	void count(const string& name, u64 value);
+	u64 counter(const string& name) const;
+	double total(void) const;
+
+	void print(ostream& out, dino_stats_format format) const;
+	void print_text(ostream& out) const;
+	void print_json(ostream& out) const;
+
+private:
+	vector<pair<string, double> > phases;
+	vector<pair<string, u64> > counters;
+};
+
+// measures the lifetime of a scope into one phase
+class dino_timer {
+public:
+	dino_timer(dino_stats& stats, const char* name) : stats(stats), name(name), start(chrono::steady_clock::now()) {}
+	~dino_timer() { stats.phase(name, chrono::duration<double>(chrono::steady_clock::now() - start).count()); }
+
+private:
+	dino_stats& stats;
+	const char* name;
+	chrono::steady_clock::time_point start;
+};
+
+void stats_print_all(ostream& out, const vector<dino_stats>& stats, dino_stats_format format);
@@ -19,6 +19,11 @@ u32 getbe32(const u8* p)
 	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | (p[3] << 0);
 }
 
+u32 getle32(const u8* p)
+{
+	return ((u32) p[3] << 24) | (p[2] << 16) | (p[1] << 8) | (p[0] << 0);
+}
+
 u32 getbe16(const u8* p)
 {
 	return (p[0] << 8) | (p[1] << 0);
@@ -29,3 +34,94 @@ u32 align(u32 offset, u32 alignment)
 	u32 mask = ~(u32)(alignment - 1);
 	return (offset + (alignment - 1)) & mask;
 }
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static u64 rotl64(u64 n, int r)
+{
+	return (n << r) | (n >> (64 - r));
+}
+
+static u64 getle64(const u8* p)
+{
+	return ((u64) getle32(p + 4) << 32) | getle32(p);
+}
+
+static u64 hash64_round(u64 acc, u64 lane)
+{
+	acc += lane * PRIME64_2;
+	acc = rotl64(acc, 31);
+	return acc * PRIME64_1;
+}
+
+static u64 hash64_merge(u64 acc, u64 v)
+{
+	acc ^= hash64_round(0, v);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+// XXH64
+u64 hash64(const u8* p, size_t size, u64 seed)
+{
+	const u8* end = p + size;
+	u64 h;
+
+	if (size >= 32)
+	{
+		u64 v1 = seed + PRIME64_1 + PRIME64_2;
+		u64 v2 = seed + PRIME64_2;
+		u64 v3 = seed;
+		u64 v4 = seed - PRIME64_1;
+
+		do
+		{
+			v1 = hash64_round(v1, getle64(p)); p += 8;
+			v2 = hash64_round(v2, getle64(p)); p += 8;
+			v3 = hash64_round(v3, getle64(p)); p += 8;
+			v4 = hash64_round(v4, getle64(p)); p += 8;
+		} while (p + 32 <= end);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = hash64_merge(h, v1);
+		h = hash64_merge(h, v2);
+		h = hash64_merge(h, v3);
+		h = hash64_merge(h, v4);
+	}
+	else
+		h = seed + PRIME64_5;
+
+	h += (u64) size;
+
+	while (p + 8 <= end)
+	{
+		h ^= hash64_round(0, getle64(p));
+		h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+		p += 8;
+	}
+
+	if (p + 4 <= end)
+	{
+		h ^= (u64) getle32(p) * PRIME64_1;
+		h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+
+	while (p < end)
+	{
+		h ^= (*p) * PRIME64_5;
+		h = rotl64(h, 11) * PRIME64_1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
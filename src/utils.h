@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include "types.h"
 
 #ifdef __cplusplus
@@ -9,10 +10,13 @@ extern "C" {
 void putbe32(u8* p, u32 n);
 void putbe16(u8* p, u16 n);
 u32 getbe32(const u8* p);
+u32 getle32(const u8* p);
 u32 getbe16(const u8* p);
 
 u32 align(u32 offset, u32 alignment);
 
+u64 hash64(const u8* p, size_t size, u64 seed);
+
 #ifdef __cplusplus
 }
 #endif
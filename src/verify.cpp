@@ -0,0 +1,244 @@
+#include "verify.hpp"
+#include "elf2dll.hpp"
+#include "utils.h"
+
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+#define VERIFY_SAME       ((size_t) -1)
+
+enum dino_verdict {
+	VERDICT_SAME,
+	VERDICT_DIFFERENT,
+	VERDICT_MISSING,
+};
+
+// a stretch of a DLL as its header and tables lay it out
+struct dino_region {
+	const char* name;
+	size_t start;
+};
+
+static size_t table_end(const vector<u8>& dll, size_t offset, u32 end)
+{
+	for (; offset + sizeof(u32) <= dll.size(); offset += sizeof(u32))
+	{
+		if (getbe32(&dll[offset]) == end)
+			return offset + sizeof(u32);
+	}
+
+	return dll.size();
+}
+
+static dino_region verify_region(const vector<u8>& dll, size_t offset)
+{
+	vector<dino_region> regions;
+	dino_region header = { "header", 0 };
+	regions.push_back(header);
+
+	if (dll.size() >= sizeof(dino_dll_header))
+	{
+		const dino_dll_header* fields = (const dino_dll_header*) &dll[0];
+		size_t header_size = getbe32(fields->header_size);
+		size_t data_offset = getbe32(fields->data_offset);
+		size_t table_offset = getbe32(fields->rodata_offset);
+
+		if (header_size <= dll.size())
+		{
+			dino_region exports = { "exports", sizeof(dino_dll_header) };
+			dino_region text = { ".text", header_size };
+			regions.push_back(exports);
+			regions.push_back(text);
+		}
+
+		if (table_offset >= header_size && table_offset < dll.size())
+		{
+			size_t gotend = table_end(dll, table_offset, DINO_GOTEND);
+			size_t gptend = table_end(dll, gotend, DINO_GPTEND);
+			size_t datend = table_end(dll, gptend, DINO_DATEND);
+
+			dino_region tables[4] = {
+				{ "GOT", table_offset },
+				{ "$gp table", gotend },
+				{ ".data table", gptend },
+				{ ".rodata", datend },
+			};
+
+			regions.insert(regions.end(), tables, tables + 4);
+		}
+
+		if (data_offset >= header_size && data_offset <= dll.size())
+		{
+			dino_region data = { ".data", data_offset };
+			regions.push_back(data);
+		}
+	}
+
+	dino_region region = regions[0];
+	for (size_t i = 1; i < regions.size(); i++)
+	{
+		if (regions[i].start <= offset && regions[i].start >= region.start)
+			region = regions[i];
+	}
+
+	return region;
+}
+
+// the first word two DLLs disagree on, VERIFY_SAME when they don't
+static size_t verify_first(const vector<u8>& output, const vector<u8>& reference)
+{
+	size_t common = min(output.size(), reference.size());
+
+	if (output.size() == reference.size() && (common == 0 || !memcmp(&output[0], &reference[0], common)))
+		return VERIFY_SAME;
+
+	size_t offset = 0;
+	while (offset < common && output[offset] == reference[offset])
+		offset++;
+
+	return offset & ~(size_t) 3;
+}
+
+static void verify_word(ostream& out, const vector<u8>& dll, size_t offset)
+{
+	if (offset + sizeof(u32) > dll.size())
+	{
+		out << "past the end";
+		return;
+	}
+
+	out << "0x" << hex << setw(8) << setfill('0') << getbe32(&dll[offset]) << dec << setfill(' ');
+}
+
+// reports a mismatch, the .text offset of the word is left in text when it lies in .text
+static dino_verdict verify_pair(const string& output_file, const string& reference_file, ostream& report, size_t& text)
+{
+	vector<u8> output, reference;
+	text = VERIFY_SAME;
+
+	if (!file_read(reference_file, reference))
+	{
+		report << reference_file << ": unable to read." << endl;
+		return VERDICT_MISSING;
+	}
+
+	if (!file_read(output_file, output))
+	{
+		report << output_file << ": missing, " << reference_file << " has no counterpart." << endl;
+		return VERDICT_MISSING;
+	}
+
+	size_t offset = verify_first(output, reference);
+	if (offset == VERIFY_SAME) return VERDICT_SAME;
+
+	// the reference knows where its sections are, the output may not
+	dino_region region = verify_region(reference, offset);
+
+	report << output_file << ": " << region.name << "+0x" << hex << offset - region.start << dec << " is ";
+	verify_word(report, output, offset);
+	report << ", the reference has ";
+	verify_word(report, reference, offset);
+
+	if (output.size() != reference.size())
+		report << " (0x" << hex << output.size() << " bytes against 0x" << reference.size() << dec << ")";
+
+	report << "." << endl;
+
+	if (!strcmp(region.name, ".text") && region.start == verify_region(output, offset).start)
+		text = offset - region.start;
+
+	return VERDICT_DIFFERENT;
+}
+
+static int verify_all(const vector<string>& output_files, const vector<string>& reference_files, function<void(size_t, size_t, ostream&)> trace, unsigned threads)
+{
+	vector<ostringstream> reports(output_files.size());
+	vector<dino_verdict> verdicts(output_files.size(), VERDICT_MISSING);
+
+	vector<size_t> order(output_files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	dino_pool pool(threads);
+	pool.run(order, [&](size_t i)
+	{
+		size_t text = VERIFY_SAME;
+		verdicts[i] = verify_pair(output_files[i], reference_files[i], reports[i], text);
+
+		if (text != VERIFY_SAME && trace)
+			trace(i, text, reports[i]);
+	});
+
+	size_t different = 0, missing = 0;
+	for (size_t i = 0; i < output_files.size(); i++)
+	{
+		cout << reports[i].str();
+
+		if (verdicts[i] == VERDICT_DIFFERENT) different++;
+		if (verdicts[i] == VERDICT_MISSING) missing++;
+	}
+
+	cout << output_files.size() - different - missing << " of " << output_files.size() << " DLLs match the reference";
+	if (missing) cout << ", " << missing << " missing";
+	cout << "." << endl;
+
+	return different || missing ? 1 : 0;
+}
+
+int verify_dirs(string output_dir, string reference_dir, unsigned threads)
+{
+	vector<string> names;
+	if (!file_list(reference_dir, names))
+	{
+		cerr << "Unable to list " << reference_dir << "." << endl;
+		return 1;
+	}
+
+	vector<string> output_files, reference_files;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		output_files.push_back(output_dir + "/" + names[i]);
+		reference_files.push_back(reference_dir + "/" + names[i]);
+	}
+
+	return verify_all(output_files, reference_files, NULL, threads);
+}
+
+int verify_jobs(const vector<dino_job>& jobs, string reference_dir, const dino_options& options, unsigned threads)
+{
+	vector<string> output_files, reference_files;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const string& file = jobs[i].dll_file;
+		size_t slash = file.find_last_of("/\\");
+
+		output_files.push_back(file);
+		reference_files.push_back(reference_dir + "/" + (slash == string::npos ? file : file.substr(slash + 1)));
+	}
+
+	// only mismatches pay for a conversion, everything else is a compare
+	return verify_all(output_files, reference_files, [&](size_t i, size_t text, ostream& report)
+	{
+		ostringstream diag;
+		dino_dll dll(options, diag);
+
+		vector<u8> image;
+		u32 bss = 0;
+
+		if (dll.build(jobs[i].elf_files, image, bss))
+		{
+			report << "  " << jobs[i].elf_files[0] << " no longer converts:" << endl << diag.str();
+			return;
+		}
+
+		vector<u8> output;
+		if (!file_read(output_files[i], output) || output != image)
+			report << "  " << output_files[i] << " is stale, its inputs convert differently now." << endl;
+
+		report << "  from " << dll.text_relocation((u32) text) << "." << endl;
+	}, threads);
+}
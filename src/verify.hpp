@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "batch.hpp"
+
+struct dino_options;
+
+using namespace std;
+
+// compares every file in the reference directory with its namesake in the
+// output directory, naming the section and first word of each mismatch
+int verify_dirs(string output_dir, string reference_dir, unsigned threads);
+
+// the same for the outputs of a manifest, where a .text mismatch is traced
+// back to its relocation by converting the inputs again
+int verify_jobs(const vector<dino_job>& jobs, string reference_dir, const dino_options& options, unsigned threads);